@@ -0,0 +1,77 @@
+#!/usr/bin/perl
+
+# Scheduling throughput benchmark. Runs every scheme over a grid of core
+# and job counts on generated workloads, and writes one row per run to
+# bench/results.csv and bench/results.json.
+#
+# The grid can be narrowed through the environment, e.g.
+#   BENCH_JOBS="1000 100000" BENCH_CORES="4" BENCH_MODES="event" ./bench.pl
+
+use strict;
+use warnings;
+use Time::HiRes qw(time);
+
+my $simulator = $ENV{BENCH_SIMULATOR} || "./simulator";
+my @schemes = split ' ', ($ENV{BENCH_SCHEMES} || "fcfs sjf psjf pri ppri rr1 rr4 rr16 ws");
+my @cores = split ' ', ($ENV{BENCH_CORES} || "1 4 16 64");
+my @jobs = split ' ', ($ENV{BENCH_JOBS} || "1000 10000 100000 1000000");
+my @modes = split ' ', ($ENV{BENCH_MODES} || "tick event");
+my $seed = $ENV{BENCH_SEED} || 1;
+
+# Mean run time of the generated jobs; arrivals are spaced to keep the
+# cores about 90% busy, so the ready queue neither starves nor explodes.
+my $mean_run = 5;
+
+my @fields = qw(scheme cores jobs mode calls steps time_units load_s run_s wall_s calls_per_s time_units_per_s max_rss_kb migrations steals);
+my @rows;
+
+mkdir "bench";
+open(my $csv, ">", "bench/results.csv") or die "Unable to write bench/results.csv: $!\n";
+print $csv join(",", @fields), "\n";
+
+printf "%-6s %5s %8s %-5s %12s %14s %10s %10s\n", "scheme", "cores", "jobs", "mode", "calls/s", "time units/s", "wall s", "rss KB";
+
+for my $n (@jobs) {
+	for my $c (@cores) {
+		my $gap = $mean_run / ($c * 0.9);
+		my $trace = "bench/workload-$n-$c.trace";
+		system("./tracegen", "-n", $n, "-s", $seed, "-a", "poisson:$gap", "-r", "exp:$mean_run", "-o", $trace, "-b") == 0
+			or die "tracegen failed\n";
+
+		for my $scheme (@schemes) {
+			for my $mode (@modes) {
+				my @args = ("-Q", "-T", "-c", $c, "-s", $scheme);
+				push @args, "-e" if $mode eq "event";
+
+				my $start = time;
+				my $stats = `$simulator @args $trace 2>&1 >/dev/null`;
+				my $wall = time - $start;
+				die "$simulator @args $trace failed\n$stats" if $?;
+
+				my %row = (scheme => $scheme, cores => $c, jobs => $n, mode => $mode, wall_s => sprintf("%.6f", $wall));
+				$row{$1} = $2 while $stats =~ /(\w+)=(\S+)/g;
+				push @rows, \%row;
+
+				print $csv join(",", map { $row{$_} } @fields), "\n";
+				printf "%-6s %5d %8d %-5s %12.0f %14.0f %10.3f %10d\n",
+					$scheme, $c, $n, $mode, $row{calls_per_s}, $row{time_units_per_s}, $wall, $row{max_rss_kb};
+			}
+		}
+
+		unlink $trace;
+	}
+}
+
+close($csv);
+
+open(my $json, ">", "bench/results.json") or die "Unable to write bench/results.json: $!\n";
+print $json "[\n";
+for my $i (0 .. $#rows) {
+	my $row = $rows[$i];
+	my @pairs = map { my $v = $row->{$_}; "\"$_\": " . ($v =~ /^-?[\d.]+$/ ? $v : "\"$v\"") } @fields;
+	print $json "  {", join(", ", @pairs), "}", ($i < $#rows ? "," : ""), "\n";
+}
+print $json "]\n";
+close($json);
+
+print "\nResults written to bench/results.csv and bench/results.json\n";
@@ -0,0 +1,95 @@
+/** @file csv2trace.c
+
+  Converts a CSV job file into a binary trace that the simulator can load
+  without parsing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libtrace/libtrace.h"
+
+typedef struct _indexed_job_t
+{
+	trace_job_t job;
+	int index;
+} indexed_job_t;
+
+int compare_indexed_jobs(const void *a, const void *b)
+{
+	const indexed_job_t *job_a = a, *job_b = b;
+
+	if (job_a->job.arrival_time != job_b->job.arrival_time)
+		return (job_a->job.arrival_time < job_b->job.arrival_time) ? -1 : 1;
+	return job_a->index - job_b->index;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <input csv> <output trace>\n", argv[0]);
+		return 1;
+	}
+
+	trace_reader_t reader;
+	if (trace_open(&reader, argv[1]) != 0)
+		return 2;
+
+	int count = 0, sorted = 1, status, i;
+	trace_job_t* jobs = malloc(trace_rows(&reader) * sizeof(trace_job_t));
+
+	if (trace_rows(&reader) > 0 && !jobs)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		trace_close(&reader);
+		return 2;
+	}
+
+	while ((status = trace_next(&reader, &jobs[count])) == 1)
+	{
+		if (count > 0 && jobs[count].arrival_time < jobs[count - 1].arrival_time)
+			sorted = 0;
+		count++;
+	}
+
+	trace_close(&reader);
+
+	if (status == -1)
+	{
+		free(jobs);
+		return 2;
+	}
+
+	/*
+	 * Records are stored in arrival order, and the simulator numbers jobs by
+	 * their position; jobs arriving at the same time keep their order.
+	 */
+	if (!sorted)
+	{
+		indexed_job_t* indexed = malloc(count * sizeof(indexed_job_t));
+		if (!indexed)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			free(jobs);
+			return 2;
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			indexed[i].job = jobs[i];
+			indexed[i].index = i;
+		}
+		qsort(indexed, count, sizeof(indexed_job_t), compare_indexed_jobs);
+		for (i = 0; i < count; i++)
+			jobs[i] = indexed[i].job;
+		free(indexed);
+
+		fprintf(stderr, "Note: \"%s\" is not in arrival order; its jobs were renumbered in arrival order.\n", argv[1]);
+	}
+
+	status = trace_write(argv[2], jobs, count);
+
+	free(jobs);
+	return (status != 0) ? 2 : 0;
+}
@@ -0,0 +1,533 @@
+/** @file libexecutor.c
+
+  Runs a workload on real threads, one worker per core, with libscheduler
+  deciding what each core runs. Jobs are released by the calling thread at
+  their arrival times; a job's running time is busy work, calibrated to the
+  requested microseconds per time unit.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "libexecutor.h"
+
+
+typedef struct _executor_job_t
+{
+	int job_id, arrival_time, run_time, priority;
+	long long remaining;//iterations of work left
+	int arrived, finished;
+	int running;//nonzero while a worker is in the middle of a chunk of it
+	long long arrival_ns, first_run_ns, finish_ns;//since the start, -1 until known
+	long long run_ns;//time spent in chunks of its work
+} executor_job_t;
+
+struct _executor_t;
+
+/*
+ * One core and its worker thread.  Everything but preempt is guarded by the
+ * executor's lock; preempt is polled by the worker while it runs a chunk.
+ */
+typedef struct _executor_core_t
+{
+	_Alignas(64) atomic_int preempt;//set when the core's job is taken away mid-chunk
+	int id;
+	int job;//job the scheduler has on this core, -1 while idle
+	long long quantum_left;//iterations left in the quantum, RR only
+	pthread_cond_t wake;
+	pthread_t thread;
+	struct _executor_t *executor;
+} executor_core_t;
+
+typedef struct _executor_t
+{
+	pthread_mutex_t lock;
+	pthread_cond_t all_done;
+	scheduler_t *scheduler;
+	scheme_t scheme;
+	FILE *out;
+
+	executor_job_t *jobs;
+	int count, finished;
+	executor_core_t *cores;
+	int core_count;
+
+	long long start_ns, unit_ns;
+	long long unit_iterations;//iterations of busy work per time unit
+	long long check_iterations;//iterations between looks at the preempt flag
+	long long quantum_iterations;
+	long preemptions;
+	int done, status;
+} executor_t;
+
+typedef struct _arrival_t
+{
+	int arrival_time, job_id;
+} arrival_t;
+
+static int compare_arrivals(const void *a, const void *b)
+{
+	const arrival_t *arrival_a = a, *arrival_b = b;
+
+	if (arrival_a->arrival_time != arrival_b->arrival_time)
+		return (arrival_a->arrival_time < arrival_b->arrival_time) ? -1 : 1;
+	return arrival_a->job_id - arrival_b->job_id;
+}
+
+static long long clock_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/*
+ * The busy work: a linear congruential generator the compiler cannot fold
+ * away.  Returns the final state, which the caller stores somewhere.
+ */
+static unsigned spin(unsigned x, long long iterations)
+{
+	long long i;
+
+	for (i = 0; i < iterations; i++)
+		x = x * 1103515245u + 12345u;
+	return x;
+}
+
+/*
+ * Measures how many iterations of spin() run per millisecond, taking the
+ * best of a few rounds so a round that was descheduled does not count.
+ */
+static long long calibrate()
+{
+	volatile unsigned sink;
+	long long best = 0;
+	int round;
+
+	for (round = 0; round < 5; round++)
+	{
+		long long start = clock_ns();
+		sink = spin(round + 1, 1 << 20);
+		long long ns = clock_ns() - start;
+
+		if (ns > 0 && (1LL << 20) * 1000000 / ns > best)
+			best = (1LL << 20) * 1000000 / ns;
+	}
+	(void)sink;
+	return (best > 0) ? best : 1;
+}
+
+
+/*
+ * Returns the time since the start in time units, as handed to the
+ * scheduler.  Called with the lock held, so the times the scheduler sees
+ * never go backwards.
+ */
+static int current_time(executor_t *ex)
+{
+	return (int)((clock_ns() - ex->start_ns) / ex->unit_ns);
+}
+
+static int valid_job(executor_t *ex, int job_id)
+{
+	return job_id >= 0 && job_id < ex->count && ex->jobs[job_id].arrived && !ex->jobs[job_id].finished;
+}
+
+/*
+ * Stops every worker and the release loop.  Called with the lock held.
+ */
+static void stop(executor_t *ex, int status)
+{
+	int i;
+
+	if (status != 0)
+		ex->status = status;
+	ex->done = 1;
+	for (i = 0; i < ex->core_count; i++)
+		pthread_cond_signal(&ex->cores[i].wake);
+	pthread_cond_signal(&ex->all_done);
+}
+
+/*
+ * Puts job_id (-1 for idle) on core with a fresh quantum.  Called with the
+ * lock held.
+ */
+static void assign(executor_t *ex, executor_core_t *core, int job_id)
+{
+	core->job = job_id;
+	core->quantum_left = ex->quantum_iterations;
+	if (job_id != -1)
+		pthread_cond_signal(&core->wake);
+}
+
+
+/*
+ * A worker: runs whatever the scheduler has on its core, a chunk at a time.
+ * A chunk is the rest of the job, or of the quantum under RR, and is cut
+ * short when an arrival preempts the job.  Between chunks the worker holds
+ * the lock and reports completions and quantum expiries to the scheduler.
+ */
+static void *worker(void *arg)
+{
+	executor_core_t *core = arg;
+	executor_t *ex = core->executor;
+	volatile unsigned sink = 0;
+	unsigned state = core->id + 1;
+	int i;
+
+	pthread_mutex_lock(&ex->lock);
+	while (!ex->done)
+	{
+		int job_id = core->job;
+
+		// A job handed over from another core may still be finishing its chunk there
+		if (job_id == -1 || ex->jobs[job_id].running)
+		{
+			pthread_cond_wait(&core->wake, &ex->lock);
+			continue;
+		}
+
+		executor_job_t *job = &ex->jobs[job_id];
+
+		if (job->remaining > 0)
+		{
+			long long chunk = job->remaining, done = 0;
+
+			if (ex->scheme == RR && core->quantum_left < chunk)
+				chunk = core->quantum_left;
+
+			job->running = 1;
+			atomic_store_explicit(&core->preempt, 0, memory_order_relaxed);
+			pthread_mutex_unlock(&ex->lock);
+
+			long long begin = clock_ns();
+			while (done < chunk && !atomic_load_explicit(&core->preempt, memory_order_relaxed))
+			{
+				long long step = (chunk - done < ex->check_iterations) ? chunk - done : ex->check_iterations;
+				state = spin(state, step);
+				done += step;
+			}
+			long long end = clock_ns();
+			sink = state;
+
+			pthread_mutex_lock(&ex->lock);
+			if (job->first_run_ns == -1)
+				job->first_run_ns = begin - ex->start_ns;
+			job->running = 0;
+			job->remaining -= done;
+			job->run_ns += end - begin;
+			core->quantum_left -= done;
+
+			if (core->job != job_id)
+			{
+				// Preempted; wake the core the job went to, if any
+				for (i = 0; i < ex->core_count; i++)
+					if (ex->cores[i].job == job_id)
+						pthread_cond_signal(&ex->cores[i].wake);
+				continue;
+			}
+		}
+
+		int time = current_time(ex);
+
+		if (job->remaining == 0)
+		{
+			if (job->first_run_ns == -1)
+				job->first_run_ns = clock_ns() - ex->start_ns;
+			job->finish_ns = clock_ns() - ex->start_ns;
+			job->finished = 1;
+			ex->finished++;
+
+			int new_job_id = scheduler_job_finished_r(ex->scheduler, core->id, job_id, time);
+			if (new_job_id != -1 && !valid_job(ex, new_job_id))
+			{
+				fprintf(ex->out, "The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				stop(ex, 3);
+				break;
+			}
+			assign(ex, core, new_job_id);
+
+			if (ex->finished == ex->count)
+				stop(ex, 0);
+		}
+		else if (ex->scheme == RR && core->quantum_left <= 0)
+		{
+			int new_job_id = scheduler_quantum_expired_r(ex->scheduler, core->id, time);
+			if (new_job_id != -1 && !valid_job(ex, new_job_id))
+			{
+				fprintf(ex->out, "The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+				stop(ex, 3);
+				break;
+			}
+			if (new_job_id != job_id)
+				ex->preemptions++;
+			assign(ex, core, new_job_id);
+		}
+	}
+	pthread_mutex_unlock(&ex->lock);
+
+	(void)sink;
+	return NULL;
+}
+
+
+/*
+ * Pins each worker to one of the CPUs the process may run on, worker i to
+ * the i-th such CPU, wrapping around when there are more cores than CPUs.
+ * Returns the number of distinct CPUs used.
+ */
+static int pin_workers(executor_t *ex)
+{
+	cpu_set_t allowed;
+	int cpus[CPU_SETSIZE], cpu_count = 0, i;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return 0;
+
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &allowed))
+			cpus[cpu_count++] = i;
+	if (cpu_count == 0)
+		return 0;
+
+	for (i = 0; i < ex->core_count; i++)
+	{
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpus[i % cpu_count], &set);
+		pthread_setaffinity_np(ex->cores[i].thread, sizeof(set), &set);
+	}
+
+	return (ex->core_count < cpu_count) ? ex->core_count : cpu_count;
+}
+
+
+/**
+  Executes the count jobs of jobs, which are numbered by their index and
+  need not be in arrival order, on options->cores worker threads. Each job
+  is released at its arrival time and does running time times unit_us
+  microseconds of busy work; the scheduler's decisions pick which worker
+  runs it, and preemption happens at the worker's next look at its flag,
+  every ten microseconds or so of work.
+
+  The scheduler is given the real elapsed time, in time units, so under
+  contention its view drifts from the simulation's. The averages printed
+  and returned in stats are measured with clock_gettime.
+
+  @param options the cores, scheme, time unit and output of the execution
+  @param jobs the workload
+  @param count number of jobs
+  @param stats set to the results of the execution if not NULL
+  @return 0 on success, 2 if memory ran out or a thread could not be started, 3 if the scheduler made an invalid decision
+ */
+int execute(const executor_options_t *options, const trace_job_t *jobs, int count, executor_stats_t *stats)
+{
+	executor_t ex;
+	arrival_t *arrivals = malloc((count > 0 ? count : 1) * sizeof(arrival_t));
+	int started = 0, cpus = 0, i;
+
+	ex.scheme = options->scheme;
+	ex.out = options->out ? options->out : stdout;
+	ex.count = count;
+	ex.finished = 0;
+	ex.core_count = options->cores;
+	ex.unit_ns = options->unit_us * 1000LL;
+	ex.preemptions = 0;
+	ex.done = (count == 0);
+	ex.status = 0;
+	ex.jobs = calloc((count > 0 ? count : 1), sizeof(executor_job_t));
+	ex.cores = aligned_alloc(_Alignof(executor_core_t), ex.core_count * sizeof(executor_core_t));
+	ex.scheduler = scheduler_create(options->cores, options->scheme);
+
+	if (!arrivals || !ex.jobs || !ex.cores || !ex.scheduler)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		ex.status = 2;
+		goto cleanup;
+	}
+
+	long long per_ms = calibrate();
+	ex.unit_iterations = per_ms * options->unit_us / 1000;
+	if (ex.unit_iterations < 1)
+		ex.unit_iterations = 1;
+	ex.check_iterations = (per_ms / 100 > 0) ? per_ms / 100 : 1;
+	ex.quantum_iterations = ex.unit_iterations * options->quantum;
+
+	for (i = 0; i < count; i++)
+	{
+		ex.jobs[i].job_id = i;
+		ex.jobs[i].arrival_time = jobs[i].arrival_time;
+		ex.jobs[i].run_time = jobs[i].run_time;
+		ex.jobs[i].priority = jobs[i].priority;
+		ex.jobs[i].remaining = ex.unit_iterations * jobs[i].run_time;
+		ex.jobs[i].arrival_ns = ex.jobs[i].first_run_ns = ex.jobs[i].finish_ns = -1;
+
+		arrivals[i].arrival_time = jobs[i].arrival_time;
+		arrivals[i].job_id = i;
+	}
+	qsort(arrivals, count, sizeof(arrival_t), compare_arrivals);
+
+	pthread_mutex_init(&ex.lock, NULL);
+	pthread_cond_init(&ex.all_done, NULL);
+	ex.start_ns = clock_ns();
+
+	for (i = 0; i < ex.core_count; i++)
+	{
+		executor_core_t *core = &ex.cores[i];
+
+		atomic_init(&core->preempt, 0);
+		core->id = i;
+		core->job = -1;
+		core->quantum_left = ex.quantum_iterations;
+		core->executor = &ex;
+		pthread_cond_init(&core->wake, NULL);
+	}
+
+	pthread_mutex_lock(&ex.lock);
+	for (started = 0; started < ex.core_count; started++)
+		if (pthread_create(&ex.cores[started].thread, NULL, worker, &ex.cores[started]) != 0)
+			break;
+	if (started < ex.core_count)
+	{
+		fprintf(stderr, "Could not start the worker threads.\n");
+		stop(&ex, 2);
+	}
+	else
+		cpus = pin_workers(&ex);
+	pthread_mutex_unlock(&ex.lock);
+
+
+	/*
+	 * Release the jobs at their arrival times, measured from here.
+	 */
+	ex.start_ns = clock_ns();
+
+	for (i = 0; i < count; i++)
+	{
+		executor_job_t *job = &ex.jobs[arrivals[i].job_id];
+		long long release = ex.start_ns + job->arrival_time * ex.unit_ns;
+		struct timespec ts = {release / 1000000000LL, release % 1000000000LL};
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+
+		pthread_mutex_lock(&ex.lock);
+		if (ex.done)
+		{
+			pthread_mutex_unlock(&ex.lock);
+			break;
+		}
+
+		job->arrived = 1;
+		job->arrival_ns = clock_ns() - ex.start_ns;
+		int core_id = scheduler_new_job_r(ex.scheduler, job->job_id, current_time(&ex), job->run_time, job->priority);
+
+		if (core_id >= 0 && core_id < ex.core_count)
+		{
+			executor_core_t *core = &ex.cores[core_id];
+
+			if (core->job != -1)
+			{
+				ex.preemptions++;
+				atomic_store_explicit(&core->preempt, 1, memory_order_relaxed);
+			}
+			assign(&ex, core, job->job_id);
+		}
+		else if (core_id != -1)
+		{
+			fprintf(ex.out, "The scheduler_new_job() selected an invalid core (core_id == %d).\n", core_id);
+			stop(&ex, 3);
+		}
+		pthread_mutex_unlock(&ex.lock);
+	}
+
+	pthread_mutex_lock(&ex.lock);
+	while (!ex.done)
+		pthread_cond_wait(&ex.all_done, &ex.lock);
+	pthread_mutex_unlock(&ex.lock);
+
+	double seconds = (clock_ns() - ex.start_ns) / 1e9;
+
+	for (i = 0; i < started; i++)
+		pthread_join(ex.cores[i].thread, NULL);
+
+
+	/*
+	 * Measured latencies, in time units and in microseconds
+	 */
+	double waiting = 0, turnaround = 0, response = 0;
+
+	for (i = 0; ex.status == 0 && i < count; i++)
+	{
+		executor_job_t *job = &ex.jobs[i];
+		long long job_turnaround = job->finish_ns - job->arrival_ns;
+		long long job_waiting = job_turnaround - job->run_time * ex.unit_ns;
+
+		turnaround += job_turnaround;
+		waiting += job_waiting;
+		response += job->first_run_ns - job->arrival_ns;
+
+		if (options->verbose)
+			fprintf(ex.out, "Job %d (arrival=%d, running time=%d, priority=%d): released at %lld us, first ran at %lld us, finished at %lld us, ran for %lld us.\n",
+					i, job->arrival_time, job->run_time, job->priority,
+					job->arrival_ns / 1000, job->first_run_ns / 1000, job->finish_ns / 1000, job->run_ns / 1000);
+	}
+
+	if (ex.status == 0)
+	{
+		if (count > 0)
+		{
+			waiting /= count;
+			turnaround /= count;
+			response /= count;
+		}
+
+		if (options->verbose)
+			fprintf(ex.out, "\n");
+		fprintf(ex.out, "Executed %d job(s) on %d core(s) pinned to %d CPU(s), %d us of work per time unit, in %.3f s.\n\n",
+				count, ex.core_count, cpus, options->unit_us, seconds);
+		fprintf(ex.out, "Average Waiting Time: %.2f (%.0f us; scheduler counted %.2f)\n",
+				waiting / ex.unit_ns, waiting / 1000, scheduler_average_waiting_time_r(ex.scheduler));
+		fprintf(ex.out, "Average Turnaround Time: %.2f (%.0f us; scheduler counted %.2f)\n",
+				turnaround / ex.unit_ns, turnaround / 1000, scheduler_average_turnaround_time_r(ex.scheduler));
+		fprintf(ex.out, "Average Response Time: %.2f (%.0f us; scheduler counted %.2f)\n",
+				response / ex.unit_ns, response / 1000, scheduler_average_response_time_r(ex.scheduler));
+		fprintf(ex.out, "Preemptions: %ld\n", ex.preemptions);
+	}
+
+	if (stats)
+	{
+		stats->jobs = count;
+		stats->average_waiting_time = waiting / ex.unit_ns;
+		stats->average_turnaround_time = turnaround / ex.unit_ns;
+		stats->average_response_time = response / ex.unit_ns;
+		stats->scheduler_average_waiting_time = scheduler_average_waiting_time_r(ex.scheduler);
+		stats->scheduler_average_turnaround_time = scheduler_average_turnaround_time_r(ex.scheduler);
+		stats->scheduler_average_response_time = scheduler_average_response_time_r(ex.scheduler);
+		stats->preemptions = ex.preemptions;
+		stats->seconds = seconds;
+	}
+
+	for (i = 0; i < ex.core_count; i++)
+		pthread_cond_destroy(&ex.cores[i].wake);
+	pthread_cond_destroy(&ex.all_done);
+	pthread_mutex_destroy(&ex.lock);
+
+cleanup:
+	if (ex.scheduler)
+		scheduler_destroy(ex.scheduler);
+	free(ex.cores);
+	free(ex.jobs);
+	free(arrivals);
+
+	return ex.status;
+}
@@ -0,0 +1,45 @@
+/** @file libexecutor.h
+ */
+
+#ifndef LIBEXECUTOR_H_
+#define LIBEXECUTOR_H_
+
+#include <stdio.h>
+
+#include "../libscheduler/libscheduler.h"
+#include "../libtrace/libtrace.h"
+
+/**
+  How a workload is executed on real threads
+*/
+typedef struct _executor_options_t
+{
+	int cores;//worker threads, one per core, pinned to the CPUs the process may use
+	scheme_t scheme;
+	int quantum;//time units of work per quantum, RR only
+	int unit_us;//microseconds of work per time unit
+	int verbose;//nonzero to print each job's timings
+	FILE *out;//where the output goes, stdout if NULL
+} executor_options_t;
+
+/**
+  Results of a finished execution. The measured averages come from
+  clock_gettime and are given in time units, so they compare directly with
+  a simulation of the same workload.
+*/
+typedef struct _executor_stats_t
+{
+	int jobs;
+	double average_waiting_time;//turnaround less the running time, as the scheduler counts it
+	double average_turnaround_time;
+	double average_response_time;
+	float scheduler_average_waiting_time;//as the scheduler counted them from the clock readings it was given
+	float scheduler_average_turnaround_time;
+	float scheduler_average_response_time;
+	long preemptions;//running jobs taken off their core by an arrival or a quantum expiry
+	double seconds;//wall time from the first release to the last completion
+} executor_stats_t;
+
+int execute(const executor_options_t *options, const trace_job_t *jobs, int count, executor_stats_t *stats);
+
+#endif /* LIBEXECUTOR_H_ */
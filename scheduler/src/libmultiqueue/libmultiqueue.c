@@ -0,0 +1,249 @@
+/** @file libmultiqueue.c
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libmultiqueue.h"
+#include "../libpriqueue/libpriqueue.h"
+
+
+/**
+  One shard, padded to its own cache lines so threads working on
+  neighbouring shards do not invalidate each other's lines.
+*/
+struct multiqueue_shard_t
+{
+	_Alignas(64) pthread_mutex_t lock;
+	priqueue_t queue;
+	atomic_int size;//copy of the queue's size, readable without the lock
+};
+
+
+/**
+  Per-thread xorshift state for picking shards, seeded on first use.
+*/
+static _Thread_local uint64_t shard_rng;
+
+static int random_shard(multiqueue_t *q)
+{
+	if (shard_rng == 0)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		shard_rng = ((uint64_t)(uintptr_t)&shard_rng * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)ts.tv_nsec ^ 1;
+	}
+
+	shard_rng ^= shard_rng << 13;
+	shard_rng ^= shard_rng >> 7;
+	shard_rng ^= shard_rng << 17;
+	return (int)((shard_rng >> 32) % (uint64_t)q->shard_count);
+}
+
+
+/**
+  Initializes the multiqueue.
+
+  Two to four shards per thread using the queue keep contention low while
+  keeping the order close to exact.
+
+  @param q a pointer to an instance of the multiqueue_t data structure
+  @param comparer a pointer to the function that compares two elements, as for priqueue_init
+  @param shards the number of shards, at least 1
+  @return 0 on success
+  @return -1 if memory could not be allocated
+ */
+int multiqueue_init(multiqueue_t *q, int(*comparer)(const void *, const void *), int shards)
+{
+	int i;
+
+	if (shards < 1)
+		shards = 1;
+
+	q->shards = aligned_alloc(_Alignof(struct multiqueue_shard_t), shards * sizeof(struct multiqueue_shard_t));
+	if (q->shards == NULL)
+		return -1;
+
+	for (i = 0; i < shards; i++)
+	{
+		pthread_mutex_init(&q->shards[i].lock, NULL);
+		priqueue_init_backend(&q->shards[i].queue, comparer, PRIQUEUE_HEAP);
+		atomic_init(&q->shards[i].size, 0);
+	}
+
+	q->shard_count = shards;
+	q->compare = comparer;
+	atomic_init(&q->size, 0);
+	return 0;
+}
+
+
+/**
+  Inserts the specified element into a random shard. Safe to call from any
+  number of threads at once.
+
+  @param q a pointer to an instance of the multiqueue_t data structure
+  @param ptr a pointer to the data to be inserted
+  @return 0 on success
+  @return -1 if memory for the element could not be allocated
+ */
+int multiqueue_offer(multiqueue_t *q, void *ptr)
+{
+	struct multiqueue_shard_t *shard = &q->shards[random_shard(q)];
+	int result, attempts;
+
+	/*
+	 * Skip shards another thread holds, picking a new one each time.  If
+	 * every pick is busy, their holders are likely descheduled, so wait on
+	 * the last one rather than spin through the timeslice.
+	 */
+	for (attempts = 1; pthread_mutex_trylock(&shard->lock) != 0; attempts++)
+	{
+		shard = &q->shards[random_shard(q)];
+		if (attempts >= 2 * q->shard_count)
+		{
+			pthread_mutex_lock(&shard->lock);
+			break;
+		}
+	}
+
+	result = priqueue_offer(&shard->queue, ptr);
+	atomic_store_explicit(&shard->size, priqueue_size(&shard->queue), memory_order_relaxed);
+	pthread_mutex_unlock(&shard->lock);
+
+	if (result == -1)
+		return -1;
+
+	atomic_fetch_add_explicit(&q->size, 1, memory_order_relaxed);
+	return 0;
+}
+
+
+/**
+  Takes the front element of shard, which the caller has locked.
+ */
+static void *take_front(multiqueue_t *q, struct multiqueue_shard_t *shard)
+{
+	void *ptr = priqueue_poll(&shard->queue);
+
+	atomic_store_explicit(&shard->size, priqueue_size(&shard->queue), memory_order_relaxed);
+	if (ptr != NULL)
+		atomic_fetch_sub_explicit(&q->size, 1, memory_order_relaxed);
+	return ptr;
+}
+
+
+/**
+  Retrieves and removes one of the elements at the front of the queue.
+  Safe to call from any number of threads at once.
+
+  Both candidate shards are locked, with trylock, before their fronts are
+  compared, so the comparator never sees an element another thread may
+  already have taken and freed.
+
+  @param q a pointer to an instance of the multiqueue_t data structure
+  @return an element near the front of the queue
+  @return NULL if the queue was found empty
+ */
+void *multiqueue_poll(multiqueue_t *q)
+{
+	int attempts, i;
+
+	for (attempts = 0; attempts < 2 * q->shard_count; attempts++)
+	{
+		struct multiqueue_shard_t *first = &q->shards[random_shard(q)];
+		struct multiqueue_shard_t *second = &q->shards[random_shard(q)];
+
+		if (atomic_load_explicit(&first->size, memory_order_relaxed) == 0)
+		{
+			struct multiqueue_shard_t *swap = first;
+			first = second;
+			second = swap;
+		}
+		if (atomic_load_explicit(&first->size, memory_order_relaxed) == 0)
+		{
+			if (atomic_load_explicit(&q->size, memory_order_relaxed) == 0)
+				return NULL;
+			continue;
+		}
+
+		if (pthread_mutex_trylock(&first->lock) != 0)
+			continue;
+
+		if (second != first && atomic_load_explicit(&second->size, memory_order_relaxed) > 0 &&
+				pthread_mutex_trylock(&second->lock) == 0)
+		{
+			void *a = priqueue_peek(&first->queue), *b = priqueue_peek(&second->queue);
+
+			if (a == NULL || (b != NULL && q->compare(b, a) < 0))
+			{
+				pthread_mutex_unlock(&first->lock);
+				first = second;
+			}
+			else
+				pthread_mutex_unlock(&second->lock);
+		}
+
+		void *ptr = take_front(q, first);
+		pthread_mutex_unlock(&first->lock);
+		if (ptr != NULL)
+			return ptr;
+	}
+
+	/*
+	 * Random picks keep missing: the queue is nearly empty or heavily
+	 * contended.  Sweep every shard, waiting for each lock in turn.
+	 */
+	for (i = 0; i < q->shard_count; i++)
+	{
+		struct multiqueue_shard_t *shard = &q->shards[i];
+
+		if (atomic_load_explicit(&shard->size, memory_order_relaxed) == 0)
+			continue;
+
+		pthread_mutex_lock(&shard->lock);
+		void *ptr = take_front(q, shard);
+		pthread_mutex_unlock(&shard->lock);
+		if (ptr != NULL)
+			return ptr;
+	}
+
+	return NULL;
+}
+
+
+/**
+  Returns the number of elements in the queue. While other threads offer
+  or poll this is only a snapshot.
+
+  @param q a pointer to an instance of the multiqueue_t data structure
+  @return the number of elements in the queue
+ */
+int multiqueue_size(multiqueue_t *q)
+{
+	return atomic_load_explicit(&q->size, memory_order_relaxed);
+}
+
+
+/**
+  Destroys and frees all the memory associated with q. No other thread may
+  be using the queue.
+
+  @param q a pointer to an instance of the multiqueue_t data structure
+ */
+void multiqueue_destroy(multiqueue_t *q)
+{
+	int i;
+
+	for (i = 0; i < q->shard_count; i++)
+	{
+		priqueue_destroy(&q->shards[i].queue);
+		pthread_mutex_destroy(&q->shards[i].lock);
+	}
+
+	free(q->shards);
+	q->shards = NULL;
+	q->shard_count = 0;
+}
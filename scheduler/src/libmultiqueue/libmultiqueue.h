@@ -0,0 +1,37 @@
+/** @file libmultiqueue.h
+ */
+
+#ifndef LIBMULTIQUEUE_H_
+#define LIBMULTIQUEUE_H_
+
+#include <stdatomic.h>
+
+/**
+  Concurrent, relaxed priority queue for many threads at once: a MultiQueue.
+
+  The elements are spread over several shards, each a priqueue_t behind its
+  own lock. An offer goes to a random shard; a poll looks at the fronts of
+  two random shards and takes the better one. No lock is ever waited on
+  while another is held and there is no global lock, so threads only
+  contend when they pick the same shard.
+
+  The price is that the order is relaxed: a poll returns one of the best
+  few elements, not always the best (with one shard the order is exact).
+  Elements and comparator follow the priqueue_t contract.
+*/
+typedef struct _multiqueue_t
+{
+  struct multiqueue_shard_t* shards;
+  int shard_count;
+  atomic_int size;//number of elements, exact once all threads are quiet
+  int (*compare)(const void*, const void*);
+} multiqueue_t;
+
+
+int    multiqueue_init   (multiqueue_t *q, int(*comparer)(const void *, const void *), int shards);
+int    multiqueue_offer  (multiqueue_t *q, void *ptr);
+void * multiqueue_poll   (multiqueue_t *q);
+int    multiqueue_size   (multiqueue_t *q);
+void   multiqueue_destroy(multiqueue_t *q);
+
+#endif /* LIBMULTIQUEUE_H_ */
@@ -3,17 +3,955 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "libpriqueue.h"
 
 /**
-struct node_t
+  Number of heap slots allocated the first time a PRIQUEUE_HEAP grows.
+*/
+#define PRIQUEUE_INITIAL_CAPACITY 16
+
+/**
+  Number of nodes in the first slab of a queue's node pool. Each later slab
+  doubles in size, up to PRIQUEUE_MAX_SLAB_NODES.
+*/
+#define PRIQUEUE_MIN_SLAB_NODES 32
+#define PRIQUEUE_MAX_SLAB_NODES 4096
+
+/**
+  Number of slots in a newly enabled identity index.
+*/
+#define PRIQUEUE_INITIAL_LOOKUP 16
+
+
+/**
+  A chunk of nodes handed out by a queue's node pool. Slabs are only
+  released together, by priqueue_destroy.
+*/
+struct node_slab_t
+{
+  struct node_slab_t* next;
+  struct node_t nodes[];
+};
+
+
+/**
+  Orders two nodes with the user's comparer, falling back to insertion order
+  so elements of equal priority leave the queue first in, first out.
+ */
+static int node_compare(priqueue_t *q, struct node_t *a, struct node_t *b)
+{
+	int compare_value = q->compare(a->value, b->value);
+	if (compare_value != 0)
+		return compare_value;
+
+	return (a->seq < b->seq) ? -1 : (a->seq > b->seq);
+}
+
+
+/**
+  Adds a slab of count nodes to the queue's free list.
+ */
+static int pool_grow(priqueue_t *q, int count)
+{
+	struct node_slab_t* slab = malloc(sizeof(struct node_slab_t) + count * sizeof(struct node_t));
+	if (slab == NULL)
+		return 0;
+
+	slab->next = q->slabs;
+	q->slabs = slab;
+
+	for (int i = count - 1; i >= 0; i--)
+	{
+		slab->nodes[i].next = q->free_nodes;
+		q->free_nodes = &slab->nodes[i];
+	}
+
+	q->pool_size += count;
+	return 1;
+}
+
+
+static struct node_t *node_create(priqueue_t *q, void *ptr)
+{
+	if (q->free_nodes == NULL)
+	{
+		int count = q->pool_size;
+		if (count < PRIQUEUE_MIN_SLAB_NODES)
+			count = PRIQUEUE_MIN_SLAB_NODES;
+		else if (count > PRIQUEUE_MAX_SLAB_NODES)
+			count = PRIQUEUE_MAX_SLAB_NODES;
+
+		if (!pool_grow(q, count))
+			return NULL;
+	}
+
+	struct node_t* new_node = q->free_nodes;
+	q->free_nodes = new_node->next;
+
+	new_node->value = ptr;
+	new_node->seq = q->seq++;
+	new_node->index = -1;
+	new_node->next = NULL;
+	new_node->parent = NULL;
+	new_node->dup_next = NULL;
+	new_node->dup_prev = NULL;
+	return new_node;
+}
+
+
+static void node_release(priqueue_t *q, struct node_t *node)
+{
+	node->next = q->free_nodes;
+	q->free_nodes = node;
+}
+
+
+/*
+ * Identity index: a linear-probing hash table keyed by value pointer. Each
+ * slot holds one node per distinct value; further nodes with the same value
+ * hang off it through dup_next/dup_prev.
+ */
+
+static int lookup_home(priqueue_t *q, void *ptr)
+{
+	//Fibonacci hashing; the low bits of a pointer are mostly alignment
+	uint64_t hash = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ull;
+	return (int)(hash >> 32) & (q->lookup_capacity - 1);
+}
+
+
+/**
+  Returns the slot holding ptr, or the empty slot where it would go.
+ */
+static int lookup_find(priqueue_t *q, void *ptr)
+{
+	int mask = q->lookup_capacity - 1;
+	int i = lookup_home(q, ptr);
+
+	while (q->lookup[i] != NULL && q->lookup[i]->value != ptr)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+
+static int lookup_resize(priqueue_t *q, int capacity)
+{
+	struct node_t** old_lookup = q->lookup;
+	int old_capacity = q->lookup_capacity;
+
+	struct node_t** lookup = calloc(capacity, sizeof(struct node_t *));
+	if (lookup == NULL)
+		return 0;
+
+	q->lookup = lookup;
+	q->lookup_capacity = capacity;
+
+	for (int i = 0; i < old_capacity; i++)
+		if (old_lookup[i] != NULL)
+			q->lookup[lookup_find(q, old_lookup[i]->value)] = old_lookup[i];
+
+	free(old_lookup);
+	return 1;
+}
+
+
+/**
+  Empties slot i, shifting back any later entries of its probe run so no
+  lookup stops early at the hole.
+ */
+static void lookup_delete_slot(priqueue_t *q, int i)
+{
+	int mask = q->lookup_capacity - 1;
+	int j = i;
+
+	while (1)
+	{
+		j = (j + 1) & mask;
+		if (q->lookup[j] == NULL)
+			break;
+
+		//leave the entry alone if its home lies cyclically in (i, j]
+		int home = lookup_home(q, q->lookup[j]->value);
+		if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+
+		q->lookup[i] = q->lookup[j];
+		i = j;
+	}
+
+	q->lookup[i] = NULL;
+	q->lookup_count--;
+}
+
+
+static int lookup_add(priqueue_t *q, struct node_t *node)
+{
+	//keep the load factor at or below one half
+	if (2 * (q->lookup_count + 1) > q->lookup_capacity && !lookup_resize(q, 2 * q->lookup_capacity))
+		return 0;
+
+	int i = lookup_find(q, node->value);
+	struct node_t* first = q->lookup[i];
+
+	if (first == NULL)
+	{
+		q->lookup[i] = node;
+		q->lookup_count++;
+	}
+	else
+	{
+		node->dup_prev = first;
+		node->dup_next = first->dup_next;
+		if (first->dup_next != NULL)
+			first->dup_next->dup_prev = node;
+		first->dup_next = node;
+	}
+
+	return 1;
+}
+
+
+static void lookup_unlink(priqueue_t *q, struct node_t *node)
+{
+	if (node->dup_prev != NULL)
+	{
+		node->dup_prev->dup_next = node->dup_next;
+		if (node->dup_next != NULL)
+			node->dup_next->dup_prev = node->dup_prev;
+		return;
+	}
+
+	int i = lookup_find(q, node->value);
+	if (node->dup_next != NULL)
+	{
+		q->lookup[i] = node->dup_next;
+		node->dup_next->dup_prev = NULL;
+	}
+	else
+	{
+		lookup_delete_slot(q, i);
+	}
+}
+
+
+/*
+ * PRIQUEUE_LIST: a doubly linked list kept in sorted order.
+ */
+
+static int list_offer(priqueue_t *q, struct node_t *new_node)
+{
+	//most RR and FCFS traffic lands at the back, so check the tail before walking from the head
+	if (q->tail == NULL || node_compare(q, new_node, q->tail) > 0)
+	{
+		new_node->next = NULL;
+		new_node->parent = q->tail;
+		if (q->tail != NULL)
+			q->tail->next = new_node;
+		else
+			q->head = new_node;
+		q->tail = new_node;
+		return q->size;
+	}
+
+	struct node_t* current_node = q->head;
+	int index = 0;
+
+	//stop at the first node new_node goes before
+	while (node_compare(q, new_node, current_node) > 0)
+	{
+		current_node = current_node->next;
+		index++;
+	}
+
+	new_node->next = current_node;
+	new_node->parent = current_node->parent;
+	if (current_node->parent != NULL)
+		current_node->parent->next = new_node;
+	else
+		q->head = new_node;
+	current_node->parent = new_node;
+
+	return index;
+}
+
+
+static void list_unlink(priqueue_t *q, struct node_t *node)
+{
+	if (node->parent != NULL)
+		node->parent->next = node->next;
+	else
+		q->head = node->next;
+
+	if (node->next != NULL)
+		node->next->parent = node->parent;
+	else
+		q->tail = node->parent;
+}
+
+
+static struct node_t *list_at(priqueue_t *q, int index)
+{
+	struct node_t* current_node;
+
+	//walk from whichever end is closer
+	if (index < q->size / 2)
+	{
+		current_node = q->head;
+		for (int i = 0; i < index; i++)
+			current_node = current_node->next;
+	}
+	else
+	{
+		current_node = q->tail;
+		for (int i = q->size - 1; i > index; i--)
+			current_node = current_node->parent;
+	}
+	return current_node;
+}
+
+
+/*
+ * PRIQUEUE_HEAP: an array-backed binary min-heap of nodes.
+ */
+
+static int heap_reserve(priqueue_t *q, int capacity)
+{
+	if (capacity <= q->capacity)
+		return 1;
+
+	int new_capacity = (q->capacity > 0) ? q->capacity : PRIQUEUE_INITIAL_CAPACITY;
+	while (new_capacity < capacity)
+		new_capacity *= 2;
+
+	struct node_t** heap = realloc(q->heap, new_capacity * sizeof(struct node_t *));
+	if (heap == NULL)
+		return 0;
+
+	q->heap = heap;
+	q->capacity = new_capacity;
+	return 1;
+}
+
+
+static void heap_place(priqueue_t *q, struct node_t *node, int i)
+{
+	q->heap[i] = node;
+	node->index = i;
+}
+
+
+static int heap_sift_up(priqueue_t *q, int i)
+{
+	struct node_t* node = q->heap[i];
+
+	while (i > 0)
+	{
+		int parent = (i - 1) / 2;
+		if (node_compare(q, node, q->heap[parent]) >= 0)
+			break;
+
+		heap_place(q, q->heap[parent], i);
+		i = parent;
+	}
+
+	heap_place(q, node, i);
+	return i;
+}
+
+
+/**
+  Moves the node at slot i down until it is no larger than its children,
+  considering only the first limit slots of the heap.
+ */
+static void heap_sift_down(priqueue_t *q, int i, int limit)
+{
+	struct node_t* node = q->heap[i];
+
+	while (1)
+	{
+		int child = 2 * i + 1;
+		if (child >= limit)
+			break;
+
+		if (child + 1 < limit && node_compare(q, q->heap[child + 1], q->heap[child]) < 0)
+			child++;
+
+		if (node_compare(q, q->heap[child], node) >= 0)
+			break;
+
+		heap_place(q, q->heap[child], i);
+		i = child;
+	}
+
+	heap_place(q, node, i);
+}
+
+
+static void heap_heapify(priqueue_t *q)
+{
+	for (int i = q->size / 2 - 1; i >= 0; i--)
+		heap_sift_down(q, i, q->size);
+}
+
+
+static int heap_offer(priqueue_t *q, struct node_t *new_node)
+{
+	if (!heap_reserve(q, q->size + 1))
+		return -1;
+
+	int i = q->size;
+	if (q->sorted && i > 0 && node_compare(q, q->heap[i - 1], new_node) > 0)
+		q->sorted = 0;
+
+	heap_place(q, new_node, i);
+
+	//appending to a sorted array keeps it sorted, and the slot is then its exact index
+	if (q->sorted)
+		return i;
+
+	//otherwise report its depth: every ancestor precedes it, and 0 still means it became the head
+	int depth = 0;
+	for (i = heap_sift_up(q, i); i > 0; i = (i - 1) / 2)
+		depth++;
+	return depth;
+}
+
+
+static void heap_unlink(priqueue_t *q, struct node_t *node)
+{
+	int i = node->index;
+	int last = q->size - 1;
+
+	if (i != last)
+	{
+		struct node_t* moved = q->heap[last];
+		heap_place(q, moved, i);
+
+		if (i > 0 && node_compare(q, moved, q->heap[(i - 1) / 2]) < 0)
+			heap_sift_up(q, i);
+		else
+			heap_sift_down(q, i, last);
+
+		q->sorted = 0;
+	}
+
+	node->index = -1;
+}
+
+
+/**
+  Restores the heap after the key of the node at slot i changed.
+ */
+static void heap_update(priqueue_t *q, struct node_t *node)
+{
+	int i = node->index;
+
+	if (q->sorted)
+	{
+		if ((i > 0 && node_compare(q, q->heap[i - 1], node) > 0) ||
+			(i < q->size - 1 && node_compare(q, node, q->heap[i + 1]) > 0))
+			q->sorted = 0;
+		else
+			return;
+	}
+
+	if (i > 0 && node_compare(q, node, q->heap[(i - 1) / 2]) < 0)
+		heap_sift_up(q, i);
+	else
+		heap_sift_down(q, i, q->size);
+}
+
+
+/**
+  Sorts the heap array in place. A sorted array is still a valid heap, so
+  the heap stays usable, and later indexed lookups are O(1) until the next
+  change that breaks the order.
+ */
+static void heap_sort(priqueue_t *q)
+{
+	if (q->sorted)
+		return;
+
+	//heapsort: repeatedly move the minimum behind the shrinking heap, leaving the array in descending order
+	for (int end = q->size - 1; end > 0; end--)
+	{
+		struct node_t* min = q->heap[0];
+		q->heap[0] = q->heap[end];
+		q->heap[end] = min;
+		heap_sift_down(q, 0, end);
+	}
+
+	for (int i = 0, j = q->size - 1; i < j; i++, j--)
+	{
+		struct node_t* temp = q->heap[i];
+		q->heap[i] = q->heap[j];
+		q->heap[j] = temp;
+	}
+
+	for (int i = 0; i < q->size; i++)
+		q->heap[i]->index = i;
+
+	q->sorted = 1;
+}
+
+
+/*
+ * PRIQUEUE_TREE: an AVL tree whose nodes also count their subtree, so
+ * elements can be found and removed by rank in O(log n).
+ */
+
+static int tree_height(struct node_t *node)
+{
+	return (node != NULL) ? node->height : 0;
+}
+
+
+static int tree_weight(struct node_t *node)
+{
+	return (node != NULL) ? node->weight : 0;
+}
+
+
+static void tree_refresh(struct node_t *node)
+{
+	int left_height = tree_height(node->left);
+	int right_height = tree_height(node->right);
+
+	node->height = 1 + ((left_height > right_height) ? left_height : right_height);
+	node->weight = 1 + tree_weight(node->left) + tree_weight(node->right);
+}
+
+
+/**
+  Points whatever referred to old_child (its parent, or the root) at new_child.
+ */
+static void tree_replace_child(priqueue_t *q, struct node_t *parent, struct node_t *old_child, struct node_t *new_child)
+{
+	if (parent == NULL)
+		q->root = new_child;
+	else if (parent->left == old_child)
+		parent->left = new_child;
+	else
+		parent->right = new_child;
+}
+
+
+static struct node_t *tree_rotate_left(priqueue_t *q, struct node_t *node)
+{
+	struct node_t* pivot = node->right;
+
+	node->right = pivot->left;
+	if (pivot->left != NULL)
+		pivot->left->parent = node;
+
+	pivot->parent = node->parent;
+	tree_replace_child(q, node->parent, node, pivot);
+
+	pivot->left = node;
+	node->parent = pivot;
+
+	tree_refresh(node);
+	tree_refresh(pivot);
+	return pivot;
+}
+
+
+static struct node_t *tree_rotate_right(priqueue_t *q, struct node_t *node)
+{
+	struct node_t* pivot = node->left;
+
+	node->left = pivot->right;
+	if (pivot->right != NULL)
+		pivot->right->parent = node;
+
+	pivot->parent = node->parent;
+	tree_replace_child(q, node->parent, node, pivot);
+
+	pivot->right = node;
+	node->parent = pivot;
+
+	tree_refresh(node);
+	tree_refresh(pivot);
+	return pivot;
+}
+
+
+/**
+  Walks from node up to the root, refreshing heights and weights and
+  rotating wherever the AVL balance was lost.
+ */
+static void tree_rebalance(priqueue_t *q, struct node_t *node)
+{
+	while (node != NULL)
+	{
+		tree_refresh(node);
+		int balance = tree_height(node->left) - tree_height(node->right);
+
+		if (balance > 1)
+		{
+			if (tree_height(node->left->left) < tree_height(node->left->right))
+				tree_rotate_left(q, node->left);
+			node = tree_rotate_right(q, node);
+		}
+		else if (balance < -1)
+		{
+			if (tree_height(node->right->right) < tree_height(node->right->left))
+				tree_rotate_right(q, node->right);
+			node = tree_rotate_left(q, node);
+		}
+
+		node = node->parent;
+	}
+}
+
+
+static struct node_t *tree_successor(struct node_t *node)
+{
+	if (node->right != NULL)
+	{
+		node = node->right;
+		while (node->left != NULL)
+			node = node->left;
+		return node;
+	}
+
+	while (node->parent != NULL && node->parent->right == node)
+		node = node->parent;
+	return node->parent;
+}
+
+
+static int tree_offer(priqueue_t *q, struct node_t *new_node)
+{
+	struct node_t* parent = NULL;
+	struct node_t* current_node = q->root;
+	int index = 0;
+	int go_left = 0;
+
+	while (current_node != NULL)
+	{
+		parent = current_node;
+		go_left = node_compare(q, new_node, current_node) < 0;
+
+		if (go_left)
+		{
+			current_node = current_node->left;
+		}
+		else
+		{
+			index += tree_weight(current_node->left) + 1;
+			current_node = current_node->right;
+		}
+	}
+
+	new_node->parent = parent;
+	new_node->left = NULL;
+	new_node->right = NULL;
+	new_node->height = 1;
+	new_node->weight = 1;
+
+	if (parent == NULL)
+		q->root = new_node;
+	else if (go_left)
+		parent->left = new_node;
+	else
+		parent->right = new_node;
+
+	if (index == 0)
+		q->head = new_node;
+
+	tree_rebalance(q, parent);
+	return index;
+}
+
+
+static void tree_unlink(priqueue_t *q, struct node_t *node)
+{
+	struct node_t* rebalance_from;
+
+	if (node == q->head)
+		q->head = tree_successor(node);
+
+	if (node->left != NULL && node->right != NULL)
+	{
+		//move the in-order successor into node's place; nodes never trade values, so handles stay valid
+		struct node_t* successor = node->right;
+		while (successor->left != NULL)
+			successor = successor->left;
+
+		if (successor->parent == node)
+		{
+			rebalance_from = successor;
+		}
+		else
+		{
+			rebalance_from = successor->parent;
+
+			rebalance_from->left = successor->right;
+			if (successor->right != NULL)
+				successor->right->parent = rebalance_from;
+
+			successor->right = node->right;
+			node->right->parent = successor;
+		}
+
+		successor->left = node->left;
+		node->left->parent = successor;
+
+		successor->parent = node->parent;
+		tree_replace_child(q, node->parent, node, successor);
+	}
+	else
+	{
+		struct node_t* child = (node->left != NULL) ? node->left : node->right;
+		if (child != NULL)
+			child->parent = node->parent;
+
+		tree_replace_child(q, node->parent, node, child);
+		rebalance_from = node->parent;
+	}
+
+	tree_rebalance(q, rebalance_from);
+}
+
+
+static struct node_t *tree_at(priqueue_t *q, int index)
+{
+	struct node_t* current_node = q->root;
+
+	while (1)
+	{
+		int left_weight = tree_weight(current_node->left);
+
+		if (index < left_weight)
+		{
+			current_node = current_node->left;
+		}
+		else if (index == left_weight)
+		{
+			return current_node;
+		}
+		else
+		{
+			index -= left_weight + 1;
+			current_node = current_node->right;
+		}
+	}
+}
+
+
+/**
+  Sorts count nodes with a bottom-up merge sort, using scratch (room for
+  count nodes) as a buffer. Already sorted input costs one pass.
+ */
+static void node_sort(priqueue_t *q, struct node_t **nodes, struct node_t **scratch, int count)
+{
+	int i;
+	for (i = 1; i < count; i++)
+		if (node_compare(q, nodes[i - 1], nodes[i]) > 0)
+			break;
+	if (i >= count)
+		return;
+
+	for (int width = 1; width < count; width *= 2)
+	{
+		for (int low = 0; low < count; low += 2 * width)
+		{
+			int middle = (low + width < count) ? low + width : count;
+			int high = (low + 2 * width < count) ? low + 2 * width : count;
+			int left = low, right = middle, out = low;
+
+			while (left < middle && right < high)
+				scratch[out++] = (node_compare(q, nodes[right], nodes[left]) < 0) ? nodes[right++] : nodes[left++];
+			while (left < middle)
+				scratch[out++] = nodes[left++];
+			while (right < high)
+				scratch[out++] = nodes[right++];
+		}
+
+		memcpy(nodes, scratch, count * sizeof(struct node_t *));
+	}
+}
+
+
+/**
+  Builds a perfectly balanced tree, which is also a valid AVL tree, from
+  count nodes in sorted order.
+ */
+static struct node_t *tree_build(struct node_t **nodes, int count, struct node_t *parent)
+{
+	if (count == 0)
+		return NULL;
+
+	int middle = count / 2;
+	struct node_t* node = nodes[middle];
+
+	node->parent = parent;
+	node->left = tree_build(nodes, middle, node);
+	node->right = tree_build(nodes + middle + 1, count - middle - 1, node);
+	tree_refresh(node);
+	return node;
+}
+
+
+/**
+  Merges count sorted nodes, all offered after everything already in the
+  queue, into a PRIQUEUE_LIST in one pass.
+ */
+static void list_merge(priqueue_t *q, struct node_t **nodes, int count)
+{
+	struct node_t* previous = NULL;
+	struct node_t* current_node = q->head;
+
+	for (int i = 0; i < count; i++)
+	{
+		while (current_node != NULL && node_compare(q, current_node, nodes[i]) < 0)
+		{
+			previous = current_node;
+			current_node = current_node->next;
+		}
+
+		nodes[i]->parent = previous;
+		nodes[i]->next = current_node;
+		if (previous != NULL)
+			previous->next = nodes[i];
+		else
+			q->head = nodes[i];
+		if (current_node != NULL)
+			current_node->parent = nodes[i];
+		else
+			q->tail = nodes[i];
+
+		previous = nodes[i];
+	}
+}
+
+
+/**
+  Merges count sorted nodes with the nodes of a PRIQUEUE_TREE and rebuilds
+  the tree from the result, using merged (room for size + count nodes).
+ */
+static void tree_merge(priqueue_t *q, struct node_t **nodes, int count, struct node_t **merged)
+{
+	struct node_t* current_node = q->head;
+	int total = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		while (current_node != NULL && node_compare(q, current_node, nodes[i]) < 0)
+		{
+			merged[total++] = current_node;
+			current_node = tree_successor(current_node);
+		}
+		merged[total++] = nodes[i];
+	}
+
+	while (current_node != NULL)
+	{
+		merged[total++] = current_node;
+		current_node = tree_successor(current_node);
+	}
+
+	q->root = tree_build(merged, total, NULL);
+	q->head = merged[0];
+}
+
+
+/*
+ * Backend independent helpers.
+ */
+
+static int backend_link(priqueue_t *q, struct node_t *node)
+{
+	if (q->backend == PRIQUEUE_HEAP)
+		return heap_offer(q, node);
+	else if (q->backend == PRIQUEUE_TREE)
+		return tree_offer(q, node);
+	else
+		return list_offer(q, node);
+}
+
+
+static void backend_unlink(priqueue_t *q, struct node_t *node)
+{
+	if (q->backend == PRIQUEUE_HEAP)
+		heap_unlink(q, node);
+	else if (q->backend == PRIQUEUE_TREE)
+		tree_unlink(q, node);
+	else
+		list_unlink(q, node);
+}
+
+static struct node_t *node_at(priqueue_t *q, int index)
+{
+	if (index >= q->size || index < 0)
+		return NULL;
+
+	if (q->backend == PRIQUEUE_HEAP)
+	{
+		if (index == 0)
+			return q->heap[0];
+
+		heap_sort(q);
+		return q->heap[index];
+	}
+	else if (q->backend == PRIQUEUE_TREE)
+	{
+		return (index == 0) ? q->head : tree_at(q, index);
+	}
+
+	return list_at(q, index);
+}
+
+
+/**
+  Creates a node for ptr and links it into the queue, storing what
+  priqueue_offer reports as its index in index.
+ */
+static struct node_t *node_insert(priqueue_t *q, void *ptr, int *index)
 {
-  void* value;
-  struct node_t* next;
-  struct node_t* parent;
+	struct node_t* new_node = node_create(q, ptr);
+	if (new_node == NULL)
+		return NULL;
+
+	if (q->lookup != NULL && !lookup_add(q, new_node))
+	{
+		node_release(q, new_node);
+		return NULL;
+	}
+
+	*index = backend_link(q, new_node);
+
+	if (*index < 0)
+	{
+		if (q->lookup != NULL)
+			lookup_unlink(q, new_node);
+		node_release(q, new_node);
+		return NULL;
+	}
+
+	q->size++;
+	return new_node;
+}
+
+
+static void *node_remove(priqueue_t *q, struct node_t *node)
+{
+	if (q->lookup != NULL)
+		lookup_unlink(q, node);
+
+	backend_unlink(q, node);
+
+	q->size--;
+
+	void *data = node->value;
+	node_release(q, node);
+	return data;
 }
-*/
 
 
 /**
@@ -27,87 +965,262 @@ struct node_t
   See also @ref comparer-page
  */
 void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
+{
+	priqueue_init_backend(q, comparer, PRIQUEUE_HEAP);
+}
+
+
+/**
+  Initializes the priqueue_t data structure with a specific storage backend.
+
+  PRIQUEUE_HEAP offers, polls and removes by handle or element in
+  O(log n). priqueue_at and priqueue_remove_at with an index above 0 sort
+  the heap in place the first time they are called after a change, so
+  walking every index in turn costs O(n log n) in total, but every removal
+  by index unsorts the heap again and costs O(n log n) on its own. Use
+  PRIQUEUE_TREE when elements are removed by rank.
+  PRIQUEUE_TREE keeps an AVL tree with subtree sizes: offers, polls,
+  priqueue_at and priqueue_remove_at are all O(log n), and peeks are O(1).
+  PRIQUEUE_LIST keeps a sorted linked list: offers are O(n) (O(1) when the
+  element belongs at the back) and polls are O(1).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param backend the storage backend to use
+  See also @ref comparer-page
+ */
+void priqueue_init_backend(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend)
 {
 	q -> size = 0;
 	q -> head = NULL;
 	q -> tail = NULL;
+	q -> heap = NULL;
+	q -> root = NULL;
+	q -> capacity = 0;
+	q -> sorted = 1;
+	q -> seq = 0;
+	q -> slabs = NULL;
+	q -> free_nodes = NULL;
+	q -> pool_size = 0;
+	q -> lookup = NULL;
+	q -> lookup_capacity = 0;
+	q -> lookup_count = 0;
+	q -> backend = backend;
 	q -> compare = comparer;
 }
 
 
+/**
+  Initializes the priqueue_t data structure with room for capacity elements
+  allocated up front, so the first capacity offers never call malloc.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param capacity the number of elements the queue is expected to hold
+  See also @ref comparer-page
+ */
+void priqueue_init_capacity(priqueue_t *q, int(*comparer)(const void *, const void *), int capacity)
+{
+	priqueue_init(q, comparer);
+	priqueue_reserve(q, capacity);
+}
+
+
+/**
+  Makes sure the queue can hold capacity elements without allocating.
+
+  Nodes are carved out of slabs owned by the queue and recycled through a
+  free list, so memory reserved here stays with the queue until
+  priqueue_destroy.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param capacity the number of elements the queue should be able to hold
+  @return 1 on success
+  @return 0 if the memory could not be allocated
+ */
+int priqueue_reserve(priqueue_t *q, int capacity)
+{
+	if (capacity > q->pool_size && !pool_grow(q, capacity - q->pool_size))
+		return 0;
+
+	if (q->backend == PRIQUEUE_HEAP && !heap_reserve(q, capacity))
+		return 0;
+
+	return 1;
+}
+
+
+/**
+  Turns on the identity index used by priqueue_remove.
+
+  The index maps each value pointer to the elements holding it, so
+  priqueue_remove costs O(k log n) for k matches with PRIQUEUE_HEAP and
+  PRIQUEUE_TREE (O(k) with PRIQUEUE_LIST) instead of visiting every element. It is kept up to
+  date by every later insertion and removal, at the cost of one hash table
+  operation each. Elements already in the queue are indexed immediately.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return 1 on success
+  @return 0 if the memory could not be allocated
+ */
+int priqueue_enable_index(priqueue_t *q)
+{
+	if (q->lookup != NULL)
+		return 1;
+
+	int capacity = PRIQUEUE_INITIAL_LOOKUP;
+	while (capacity < 2 * q->size)
+		capacity *= 2;
+
+	q->lookup = calloc(capacity, sizeof(struct node_t *));
+	if (q->lookup == NULL)
+		return 0;
+
+	q->lookup_capacity = capacity;
+	q->lookup_count = 0;
+
+	if (q->backend == PRIQUEUE_HEAP)
+	{
+		for (int i = 0; i < q->size; i++)
+			lookup_add(q, q->heap[i]);
+	}
+	else if (q->backend == PRIQUEUE_TREE)
+	{
+		for (struct node_t* node = q->head; node != NULL; node = tree_successor(node))
+			lookup_add(q, node);
+	}
+	else
+	{
+		for (struct node_t* node = q->head; node != NULL; node = node->next)
+			lookup_add(q, node);
+	}
+
+	return 1;
+}
+
+
 /**
   Inserts the specified element into this priority queue.
 
+  Elements that compare equal are kept in the order they were offered.
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
   @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  With PRIQUEUE_HEAP the exact index is only known while the heap is sorted;
+  otherwise this is a lower bound on it, which is still 0 exactly when ptr
+  became the front of the queue.
+  @return -1 if memory for the element could not be allocated
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
-	struct node_t* new_node = malloc(sizeof( struct node_t));
-	new_node->value = ptr;
-	new_node->parent = NULL;
-	new_node->next = NULL;
-	int index = 0; //location of insertion into queue, auto set to 0 for empty queue index  
-	
-	if (q->head == NULL)//if queue is empty
+	int index;
+	if (node_insert(q, ptr, &index) == NULL)
+		return -1;
+
+	return (index);
+}
+
+
+/**
+  Inserts n elements into this priority queue at once.
+
+  Elements end up in exactly the order n calls to priqueue_offer, in the
+  order given, would have produced. With PRIQUEUE_HEAP the new elements are
+  appended and the heap is rebuilt in O(size + n). With PRIQUEUE_LIST and
+  PRIQUEUE_TREE they are sorted (a single pass if already in order), then
+  merged with the queue in O(size + n). Either way all memory is allocated
+  up front, so on failure the queue is left unchanged.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs the elements to insert
+  @param n the number of elements in ptrs
+  @return n on success
+  @return -1 if memory for the elements could not be allocated
+ */
+int priqueue_offer_bulk(priqueue_t *q, void **ptrs, int n)
+{
+	if (n <= 0)
+		return 0;
+
+	if (!priqueue_reserve(q, q->size + n))
+		return -1;
+
+	if (q->lookup != NULL)
 	{
-		q->head = new_node;
-		q->tail = new_node;
-		q->size = q->size + 1;
+		int capacity = q->lookup_capacity;
+		while (2 * (q->lookup_count + n) > capacity)
+			capacity *= 2;
+
+		if (capacity != q->lookup_capacity && !lookup_resize(q, capacity))
+			return -1;
 	}
-	else//if queue is not empty need to compare until find a proper place
+
+	struct node_t** nodes = NULL;
+	struct node_t** scratch = NULL;
+	if (q->backend != PRIQUEUE_HEAP)
 	{
-		struct node_t* current_node = q->head;
-		int compare_value;//temp value to hold compare function return
-		int search = 1;
-		while (search == 1)//while still searching
-		{			
-			if (current_node == NULL)//if current node is null, reached end of list and must insert at end 
-			{
-				search = 0;//signal no longer searching for a place
-			}
-			else 
-			{
-				compare_value = q->compare(new_node->value, current_node->value);
-				if (compare_value < 0)//if new_node value has higher priority and goes before current node
-				{
-					search = 0;//end the search
-				}
-				else//else keep searching
-				{
-					current_node = current_node->next;
-					index = index + 1;					
-				}
-			}
-		}
-		
-		if (current_node == NULL)//if no node found that is less priority add to back
+		nodes = malloc(n * sizeof(struct node_t *));
+		scratch = malloc((q->size + n) * sizeof(struct node_t *));
+		if (nodes == NULL || scratch == NULL)
 		{
-			q->tail->next = new_node;
-			new_node->parent = q->tail;
-			q->tail = new_node;
-			q->size = q->size+1;
-			index = index - 1;//need to go back one to deal with going past the last node
+			free(nodes);
+			free(scratch);
+			return -1;
 		}
-		else if( index == 0)
+	}
+
+	//nothing below can fail: the pool, heap and index were sized above
+	int old_size = q->size;
+	for (int i = 0; i < n; i++)
+	{
+		struct node_t* new_node = node_create(q, ptrs[i]);
+		if (q->lookup != NULL)
+			lookup_add(q, new_node);
+
+		if (q->backend == PRIQUEUE_HEAP)
 		{
-			q->head->parent = new_node;
-			new_node->next = q->head;
-			q->head = new_node;
-			q->size = q->size +1;
+			int slot = old_size + i;
+			if (q->sorted && slot > 0 && node_compare(q, q->heap[slot - 1], new_node) > 0)
+				q->sorted = 0;
+			heap_place(q, new_node, slot);
 		}
 		else
 		{
-			struct node_t* previous = current_node->parent;
-			previous->next = new_node;
-			new_node->parent = previous;
-			new_node->next = current_node;
-			current_node->parent = new_node;
-			q->size = q->size + 1;
+			nodes[i] = new_node;
 		}
 	}
-	return (index);
+
+	if (q->backend == PRIQUEUE_HEAP)
+	{
+		q->size += n;
+
+		//a small batch into a large heap is cheaper to sift in one at a time
+		if (!q->sorted && n <= old_size / 16)
+		{
+			for (int i = old_size; i < q->size; i++)
+				heap_sift_up(q, i);
+		}
+		else if (!q->sorted)
+		{
+			heap_heapify(q);
+		}
+	}
+	else
+	{
+		node_sort(q, nodes, scratch, n);
+
+		if (q->backend == PRIQUEUE_TREE)
+			tree_merge(q, nodes, n, scratch);
+		else
+			list_merge(q, nodes, n);
+
+		q->size += n;
+	}
+
+	free(nodes);
+	free(scratch);
+	return n;
 }
 
 
@@ -121,14 +1234,17 @@ int priqueue_offer(priqueue_t *q, void *ptr)
  */
 void *priqueue_peek(priqueue_t *q)
 {
-	if (q -> head == NULL)
+	if (q -> size == 0)
 	{
 		return NULL;
 	}
+	else if (q -> backend == PRIQUEUE_HEAP)
+	{
+		return q -> heap[0] -> value;
+	}
 	else
 	{
-		void* data = q -> head -> value;
-		return data;
+		return q -> head -> value;
 	}
 }
 
@@ -143,32 +1259,12 @@ void *priqueue_peek(priqueue_t *q)
  */
 void *priqueue_poll(priqueue_t *q)
 {
-	void* data = q -> head -> value;
-	if( q -> size == 0)
-		{
-			return NULL;
-		}
-	else if(q -> size == 1)
+	if (q -> size == 0)
 	{
-		free (q -> head);
-		q -> head = NULL:
-		q -> size--;
-		return data;
-	}
-	else
-	{
-		struct node_t* temp = q -> head;
-<<<<<<< HEAD
-		q -> head = q -> head -> next;
-		free (q -> head);
-=======
-		q -> head = temp -> next;
-		free (temp);
-		temp = NULL;
->>>>>>> john
-		q -> size--;
-		return data;
+		return NULL;
 	}
+
+	return node_remove(q, node_at(q, 0));
 }
 
 
@@ -176,6 +1272,10 @@ void *priqueue_poll(priqueue_t *q)
   Returns the element at the specified position in this list, or NULL if
   the queue does not contain an index'th element.
 
+  O(1) for index 0. Otherwise O(n) with PRIQUEUE_LIST, O(log n) with
+  PRIQUEUE_TREE, and with PRIQUEUE_HEAP O(n log n) for the first call after
+  the queue changed, since the heap is sorted in place, then O(1).
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of retrieved element
   @return the index'th element in the queue
@@ -183,24 +1283,13 @@ void *priqueue_poll(priqueue_t *q)
  */
 void *priqueue_at(priqueue_t *q, int index)
 {
-	struct node_t* temp = q -> head;
-	if(q -> size == 0)
-	{
-		return NULL;
-	}
-	else if (index >= q-> size || index < 0)
+	struct node_t* node = node_at(q, index);
+	if (node == NULL)
 	{
 		return NULL;
 	}
-	 else
-		{
-		for (int i = 0; i < index; i++)
-		{
-			temp = temp -> next;
-		}
-		return temp -> value;
 
-		}
+	return node -> value;
 }
 
 
@@ -208,6 +1297,8 @@ void *priqueue_at(priqueue_t *q, int index)
   Removes all instances of ptr from the queue.
 
   This function should not use the comparer function, but check if the data contained in each element of the queue is equal (==) to ptr.
+  Once priqueue_enable_index has been called, only the matching elements
+  are visited.
 
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr address of element to be removed
@@ -215,7 +1306,69 @@ void *priqueue_at(priqueue_t *q, int index)
  */
 int priqueue_remove(priqueue_t *q, void *ptr)
 {
+	int removed = 0;
+
+	if (q->lookup != NULL)
+	{
+		int i = lookup_find(q, ptr);
+		struct node_t* node = q->lookup[i];
+		if (node == NULL)
+			return 0;
+
+		lookup_delete_slot(q, i);
+
+		while (node != NULL)
+		{
+			struct node_t* next_node = node->dup_next;
+
+			backend_unlink(q, node);
+
+			q->size--;
+			node_release(q, node);
+			removed++;
+
+			node = next_node;
+		}
+	}
+	else if (q->backend == PRIQUEUE_HEAP)
+	{
+		//compact the survivors in place (preserving any sorted order), then restore the heap in O(n)
+		int kept = 0;
+		for (int i = 0; i < q->size; i++)
+		{
+			struct node_t* node = q->heap[i];
+			if (node->value == ptr)
+			{
+				node_release(q, node);
+				removed++;
+			}
+			else
+			{
+				heap_place(q, node, kept++);
+			}
+		}
+
+		q->size = kept;
+		if (removed > 0 && !q->sorted)
+			heap_heapify(q);
+	}
+	else
+	{
+		struct node_t* current_node = q->head;
+		while (current_node != NULL)
+		{
+			//removal never changes the order of the remaining nodes, so the successor found now stays correct
+			struct node_t* next_node = (q->backend == PRIQUEUE_TREE) ? tree_successor(current_node) : current_node->next;
+			if (current_node->value == ptr)
+			{
+				node_remove(q, current_node);
+				removed++;
+			}
+			current_node = next_node;
+		}
+	}
 
+	return removed;
 }
 
 
@@ -223,6 +1376,11 @@ int priqueue_remove(priqueue_t *q, void *ptr)
   Removes the specified index from the queue, moving later elements up
   a spot in the queue to fill the gap.
 
+  O(log n) for index 0. Otherwise O(n) with PRIQUEUE_LIST and O(log n) with
+  PRIQUEUE_TREE, but O(n log n) with PRIQUEUE_HEAP, the default: the heap
+  is sorted to find the index, and the removal unsorts it again. Callers
+  that remove by rank should pick PRIQUEUE_TREE with priqueue_init_backend.
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of element to be removed
   @return the element removed from the queue
@@ -230,42 +1388,156 @@ int priqueue_remove(priqueue_t *q, void *ptr)
  */
 void *priqueue_remove_at(priqueue_t *q, int index)
 {
-	if (index >= q->size || index < 0 || q->size == 0)
+	struct node_t* node = node_at(q, index);
+	if (node == NULL)
 	{
 		return (NULL);
 	}
+
+	return node_remove(q, node);
+}
+
+
+/**
+  Inserts the specified element into this priority queue and returns a
+  handle to it.
+
+  The handle can later be passed to priqueue_remove_handle or
+  priqueue_update_handle, which avoid searching the queue for the element.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @return a handle to the inserted element
+  @return NULL if memory for the element could not be allocated
+ */
+priqueue_handle_t priqueue_offer_handle(priqueue_t *q, void *ptr)
+{
+	int index;
+	return node_insert(q, ptr, &index);
+}
+
+
+/**
+  Removes the element referred to by handle from the queue.
+
+  O(log n) with PRIQUEUE_HEAP and PRIQUEUE_TREE, O(1) with PRIQUEUE_LIST.
+  The handle is no longer valid afterwards.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle for an element still in q
+  @return the element removed from the queue
+ */
+void *priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	return node_remove(q, handle);
+}
+
+
+/**
+  Moves the element referred to by handle to its new position after its
+  priority changed.
+
+  Call this after changing whatever the comparer looks at. The element keeps
+  its original place among elements of equal priority. O(log n) with
+  PRIQUEUE_HEAP and PRIQUEUE_TREE, O(n) with PRIQUEUE_LIST.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle for an element still in q
+ */
+void priqueue_update_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	if (q->backend == PRIQUEUE_HEAP)
+	{
+		heap_update(q, handle);
+	}
 	else
 	{
-		struct node_t* current_node = q->head;
-		
-		for (int i = 0; i < index; i++)
-		{
-			current_node = current_node->next;
-		}
-		
-		void *return_value = current_node->value;
-		
-		if (index == 0)//remove head
-		{
-			q->head = q->head->next;
-			q->head->parent = NULL;
-		}
-		else if(index == (q->size -1))//remove tail
-		{
-			q->tail = q->tail->parent;
-			q->tail->next = NULL;
-		}
-		else
-		{
-			struct node_t* previous_node = current_node->parent;
-			struct node_t* next_node = current_node->next;
-			previous_node->next = next_node;
-			next_node->parent = previous_node;
-		}
-		free(current_node);
-		return (return_value);
+		backend_unlink(q, handle);
+		backend_link(q, handle);
 	}
-	return(NULL);
+}
+
+
+/**
+  Starts walking the queue in priority order.
+
+  The walk visits every element once in O(n) total without allocating.
+  With PRIQUEUE_HEAP the heap is first sorted in place, which costs
+  O(n log n) only if the queue changed since it was last sorted. Changing
+  the queue invalidates the iterator.
+
+  @code
+  priqueue_iter_t it;
+  for (priqueue_iter_begin(q, &it); !priqueue_iter_end(&it); )
+      visit(priqueue_iter_next(&it));
+  @endcode
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param it the iterator to initialize
+ */
+void priqueue_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	it->q = q;
+	it->node = q->head;
+	it->index = 0;
+
+	if (q->backend == PRIQUEUE_HEAP)
+		heap_sort(q);
+}
+
+
+/**
+  Returns whether the iterator has visited every element.
+
+  @param it an iterator started with priqueue_iter_begin
+  @return nonzero once there are no more elements
+  @return 0 if priqueue_iter_next will return another element
+ */
+int priqueue_iter_end(priqueue_iter_t *it)
+{
+	if (it->q->backend == PRIQUEUE_HEAP)
+		return it->index >= it->q->size;
+
+	return it->node == NULL;
+}
+
+
+/**
+  Returns the next element in priority order and advances the iterator.
+
+  @param it an iterator started with priqueue_iter_begin
+  @return the next element
+  @return NULL if every element has been visited
+ */
+void *priqueue_iter_next(priqueue_iter_t *it)
+{
+	if (priqueue_iter_end(it))
+		return NULL;
+
+	if (it->q->backend == PRIQUEUE_HEAP)
+		return it->q->heap[it->index++]->value;
+
+	struct node_t* node = it->node;
+	it->node = (it->q->backend == PRIQUEUE_TREE) ? tree_successor(node) : node->next;
+	return node->value;
+}
+
+
+/**
+  Calls visitor on every element of the queue in priority order.
+
+  Costs the same as walking with priqueue_iter_begin. The visitor must not
+  change the queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param visitor function called as visitor(element, ctx) for each element
+  @param ctx passed through to every call of visitor
+ */
+void priqueue_foreach(priqueue_t *q, void(*visitor)(void *, void *), void *ctx)
+{
+	priqueue_iter_t it;
+	for (priqueue_iter_begin(q, &it); !priqueue_iter_end(&it); )
+		visitor(priqueue_iter_next(&it), ctx);
 }
 
 
@@ -288,8 +1560,26 @@ int priqueue_size(priqueue_t *q)
  */
 void priqueue_destroy(priqueue_t *q)
 {
-	while (q -> size != 0)
+	//every node lives in a slab, so there is no need to visit the elements
+	while (q->slabs != NULL)
 	{
-		priqueue_poll(q);
+		struct node_slab_t* next_slab = q->slabs->next;
+		free(q->slabs);
+		q->slabs = next_slab;
 	}
+	free(q->heap);
+	free(q->lookup);
+
+	q -> size = 0;
+	q -> head = NULL;
+	q -> tail = NULL;
+	q -> heap = NULL;
+	q -> root = NULL;
+	q -> capacity = 0;
+	q -> sorted = 1;
+	q -> free_nodes = NULL;
+	q -> pool_size = 0;
+	q -> lookup = NULL;
+	q -> lookup_capacity = 0;
+	q -> lookup_count = 0;
 }
@@ -4,28 +4,77 @@
 #ifndef LIBPRIQUEUE_H_
 #define LIBPRIQUEUE_H_
 
+/**
+  Constants which select how a priqueue_t stores its elements
+*/
+typedef enum {PRIQUEUE_LIST = 0, PRIQUEUE_HEAP, PRIQUEUE_TREE} priqueue_backend_t;
+
 struct node_t
 {
   void* value;
-  struct node_t* next;//points to next node
-  struct node_t* parent;//points to previous node
-}
+  unsigned long seq;//insertion order, breaks ties between equal priorities
+  int index;//position in the heap array (PRIQUEUE_HEAP)
+  struct node_t* next;//points to next node (PRIQUEUE_LIST), or next free node in the pool
+  struct node_t* parent;//points to previous node (PRIQUEUE_LIST) or parent node (PRIQUEUE_TREE)
+  struct node_t* left;//left child (PRIQUEUE_TREE)
+  struct node_t* right;//right child (PRIQUEUE_TREE)
+  int height;//height of the subtree rooted here (PRIQUEUE_TREE)
+  int weight;//number of nodes in the subtree rooted here (PRIQUEUE_TREE)
+  struct node_t* dup_next;//next node holding the same value (identity index)
+  struct node_t* dup_prev;//previous node holding the same value, NULL for the one in the index
+};
+
+struct node_slab_t;
+
+/**
+  Stable reference to one element of a priqueue_t. A handle stays valid until
+  its element leaves the queue, by whatever call removes it.
+*/
+typedef struct node_t* priqueue_handle_t;
 
 /**
   Priqueue Data Structure
 */
 typedef struct _priqueue_t
 {
-  struct node_t* head;//points to the first object in the queue
-  struct node_t* tail;//points to last object in queue
+  struct node_t* head;//points to the first object in the queue (PRIQUEUE_LIST, PRIQUEUE_TREE)
+  struct node_t* tail;//points to last object in queue (PRIQUEUE_LIST)
+  struct node_t** heap;//binary min-heap of nodes (PRIQUEUE_HEAP)
+  struct node_t* root;//root of the AVL tree of nodes (PRIQUEUE_TREE)
+  int capacity;//number of slots allocated in heap
+  int sorted;//nonzero while heap is also in fully sorted order
+  unsigned long seq;//sequence number given to the next inserted node
+  struct node_slab_t* slabs;//chunks of nodes owned by this queue
+  struct node_t* free_nodes;//unused nodes, linked through next
+  int pool_size;//number of nodes allocated across all slabs
+  struct node_t** lookup;//open-addressing table from value pointer to its nodes, NULL when disabled
+  int lookup_capacity;//number of slots in lookup, always a power of two
+  int lookup_count;//number of distinct values in lookup
   int size;
+  priqueue_backend_t backend;
   int (*compare)(const void*, const void*);
 } priqueue_t;
 
+/**
+  Cursor for walking a priqueue_t in priority order. It needs no allocation
+  and is invalidated by any change to the queue.
+*/
+typedef struct _priqueue_iter_t
+{
+  priqueue_t* q;
+  struct node_t* node;//next node to visit (PRIQUEUE_LIST, PRIQUEUE_TREE)
+  int index;//next heap slot to visit (PRIQUEUE_HEAP)
+} priqueue_iter_t;
+
 
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_backend(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend);
+void   priqueue_init_capacity(priqueue_t *q, int(*comparer)(const void *, const void *), int capacity);
+int    priqueue_reserve  (priqueue_t *q, int capacity);
+int    priqueue_enable_index(priqueue_t *q);
 
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+int    priqueue_offer_bulk(priqueue_t *q, void **ptrs, int n);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
 void * priqueue_at       (priqueue_t *q, int index);
@@ -33,6 +82,15 @@ int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
 int    priqueue_size     (priqueue_t *q);
 
+priqueue_handle_t priqueue_offer_handle (priqueue_t *q, void *ptr);
+void * priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle);
+void   priqueue_update_handle(priqueue_t *q, priqueue_handle_t handle);
+
+void   priqueue_iter_begin(priqueue_t *q, priqueue_iter_t *it);
+int    priqueue_iter_end (priqueue_iter_t *it);
+void * priqueue_iter_next(priqueue_iter_t *it);
+void   priqueue_foreach  (priqueue_t *q, void(*visitor)(void *, void *), void *ctx);
+
 void   priqueue_destroy  (priqueue_t *q);
 
 #endif /* LIBPQUEUE_H_ */
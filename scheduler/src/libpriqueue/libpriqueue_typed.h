@@ -0,0 +1,211 @@
+/** @file libpriqueue_typed.h
+
+  Type-specialized priority queues generated at compile time.
+
+  PRIQUEUE_DEFINE(name, key_type, key_less) declares name_t together with
+  static inline name_init, name_reserve, name_offer, name_peek,
+  name_peek_key, name_poll, name_size, name_foreach and name_destroy. Keys
+  are stored by value next to their element in one contiguous 4-ary heap,
+  and are ordered by key_less(a, b), a function or function-like macro
+  returning nonzero when key a has higher priority than key b. Both can be
+  inlined, so a comparison is a plain key comparison with no indirect call
+  and no pointer chase into the element. As in priqueue_t, elements with
+  equal keys leave the queue in the order they were offered.
+
+  @code
+  PRIQUEUE_DEFINE(job_queue, int, PRIQUEUE_LESS)
+
+  job_queue_t q;
+  job_queue_init(&q);
+  job_queue_offer(&q, job->remaining_time, job);
+  job = job_queue_poll(&q);
+  job_queue_destroy(&q);
+  @endcode
+ */
+
+#ifndef LIBPRIQUEUE_TYPED_H_
+#define LIBPRIQUEUE_TYPED_H_
+
+#include <stdlib.h>
+
+/**
+  key_less for any key type with a built-in < operator.
+*/
+#define PRIQUEUE_LESS(a, b) ((a) < (b))
+
+/**
+  Children per heap node. Four children share a cache line or two, which
+  halves the depth of the heap without costing more cache misses per level.
+*/
+#define PRIQUEUE_TYPED_ARITY 4
+
+#define PRIQUEUE_DEFINE(name, key_type, key_less)                              \
+                                                                               \
+typedef struct _##name##_entry_t                                               \
+{                                                                              \
+  key_type key;                                                                \
+  unsigned long seq;/* insertion order, breaks ties between equal keys */     \
+  void* value;                                                                 \
+} name##_entry_t;                                                              \
+                                                                               \
+typedef struct _##name##_t                                                     \
+{                                                                              \
+  name##_entry_t* entries;                                                     \
+  int size;                                                                    \
+  int capacity;                                                                \
+  int sorted;/* nonzero while entries are also in fully sorted order */       \
+  unsigned long seq;                                                           \
+} name##_t;                                                                    \
+                                                                               \
+static inline int name##_before(const name##_entry_t *a, const name##_entry_t *b) \
+{                                                                              \
+	if (key_less(a->key, b->key))                                              \
+		return 1;                                                              \
+	if (key_less(b->key, a->key))                                              \
+		return 0;                                                              \
+	return a->seq < b->seq;                                                    \
+}                                                                              \
+                                                                               \
+static inline void name##_sift_up(name##_t *q, int i)                          \
+{                                                                              \
+	name##_entry_t entry = q->entries[i];                                      \
+	while (i > 0)                                                              \
+	{                                                                          \
+		int parent = (i - 1) / PRIQUEUE_TYPED_ARITY;                           \
+		if (!name##_before(&entry, &q->entries[parent]))                       \
+			break;                                                             \
+		q->entries[i] = q->entries[parent];                                    \
+		i = parent;                                                            \
+	}                                                                          \
+	q->entries[i] = entry;                                                     \
+}                                                                              \
+                                                                               \
+static inline void name##_sift_down(name##_t *q, int i, int limit)             \
+{                                                                              \
+	name##_entry_t entry = q->entries[i];                                      \
+	while (1)                                                                  \
+	{                                                                          \
+		int first = PRIQUEUE_TYPED_ARITY * i + 1;                              \
+		if (first >= limit)                                                    \
+			break;                                                             \
+		int last = first + PRIQUEUE_TYPED_ARITY;                               \
+		if (last > limit)                                                      \
+			last = limit;                                                      \
+		int best = first;                                                      \
+		for (int child = first + 1; child < last; child++)                     \
+			if (name##_before(&q->entries[child], &q->entries[best]))          \
+				best = child;                                                  \
+		if (!name##_before(&q->entries[best], &entry))                         \
+			break;                                                             \
+		q->entries[i] = q->entries[best];                                      \
+		i = best;                                                              \
+	}                                                                          \
+	q->entries[i] = entry;                                                     \
+}                                                                              \
+                                                                               \
+static inline void name##_init(name##_t *q)                                    \
+{                                                                              \
+	q->entries = NULL;                                                         \
+	q->size = 0;                                                               \
+	q->capacity = 0;                                                           \
+	q->sorted = 1;                                                             \
+	q->seq = 0;                                                                \
+}                                                                              \
+                                                                               \
+/* Returns 1 on success, 0 if the memory could not be allocated. */           \
+static inline int name##_reserve(name##_t *q, int capacity)                    \
+{                                                                              \
+	if (capacity <= q->capacity)                                               \
+		return 1;                                                              \
+	int new_capacity = (q->capacity > 0) ? q->capacity : 16;                   \
+	while (new_capacity < capacity)                                            \
+		new_capacity *= 2;                                                     \
+	name##_entry_t* entries = realloc(q->entries, new_capacity * sizeof(name##_entry_t)); \
+	if (entries == NULL)                                                       \
+		return 0;                                                              \
+	q->entries = entries;                                                      \
+	q->capacity = new_capacity;                                                \
+	return 1;                                                                  \
+}                                                                              \
+                                                                               \
+/* Returns 1 on success, 0 if the memory could not be allocated. */           \
+static inline int name##_offer(name##_t *q, key_type key, void *value)         \
+{                                                                              \
+	if (q->size == q->capacity && !name##_reserve(q, q->size + 1))             \
+		return 0;                                                              \
+	name##_entry_t* entry = &q->entries[q->size];                              \
+	entry->key = key;                                                          \
+	entry->seq = q->seq++;                                                     \
+	entry->value = value;                                                      \
+	if (q->sorted && q->size > 0 && key_less(key, q->entries[q->size - 1].key)) \
+		q->sorted = 0;                                                         \
+	q->size++;                                                                 \
+	if (!q->sorted)                                                            \
+		name##_sift_up(q, q->size - 1);                                        \
+	return 1;                                                                  \
+}                                                                              \
+                                                                               \
+static inline void *name##_peek(name##_t *q)                                   \
+{                                                                              \
+	return (q->size > 0) ? q->entries[0].value : NULL;                         \
+}                                                                              \
+                                                                               \
+/* Only meaningful while the queue is not empty. */                           \
+static inline key_type name##_peek_key(name##_t *q)                            \
+{                                                                              \
+	return q->entries[0].key;                                                  \
+}                                                                              \
+                                                                               \
+static inline void *name##_poll(name##_t *q)                                   \
+{                                                                              \
+	if (q->size == 0)                                                          \
+		return NULL;                                                           \
+	void* value = q->entries[0].value;                                         \
+	q->size--;                                                                 \
+	if (q->size > 0)                                                           \
+	{                                                                          \
+		q->entries[0] = q->entries[q->size];                                   \
+		name##_sift_down(q, 0, q->size);                                       \
+		q->sorted = 0;                                                         \
+	}                                                                          \
+	return value;                                                              \
+}                                                                              \
+                                                                               \
+static inline int name##_size(name##_t *q)                                     \
+{                                                                              \
+	return q->size;                                                            \
+}                                                                              \
+                                                                               \
+/* Visits every element in priority order. The heap is sorted in place     \
+   first (a sorted array is still a valid heap), which costs O(n log n)    \
+   only if the queue changed since the last sort. */                        \
+static inline void name##_foreach(name##_t *q, void(*visitor)(void *, void *), void *ctx) \
+{                                                                              \
+	if (!q->sorted)                                                            \
+	{                                                                          \
+		for (int end = q->size - 1; end > 0; end--)                            \
+		{                                                                      \
+			name##_entry_t min = q->entries[0];                                \
+			q->entries[0] = q->entries[end];                                   \
+			q->entries[end] = min;                                             \
+			name##_sift_down(q, 0, end);                                       \
+		}                                                                      \
+		for (int i = 0, j = q->size - 1; i < j; i++, j--)                      \
+		{                                                                      \
+			name##_entry_t temp = q->entries[i];                               \
+			q->entries[i] = q->entries[j];                                     \
+			q->entries[j] = temp;                                              \
+		}                                                                      \
+		q->sorted = 1;                                                         \
+	}                                                                          \
+	for (int i = 0; i < q->size; i++)                                          \
+		visitor(q->entries[i].value, ctx);                                     \
+}                                                                              \
+                                                                               \
+static inline void name##_destroy(name##_t *q)                                 \
+{                                                                              \
+	free(q->entries);                                                          \
+	name##_init(q);                                                            \
+}
+
+#endif /* LIBPRIQUEUE_TYPED_H_ */
@@ -4,9 +4,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 
 #include "libscheduler.h"
 #include "../libpriqueue/libpriqueue.h"
+#include "../libpriqueue/libpriqueue_typed.h"
 
 
 /**
@@ -16,10 +18,283 @@
 */
 typedef struct _job_t
 {
-
+	int job_number;
+	int arrival_time;
+	int running_time;
+	int priority;
+	int remaining_time;//time left to run as of last_scheduled_time
+	int last_scheduled_time;//when the job last started running on a core
+	int first_run_time;//when the job first ran, -1 until then
+	int core_id;//core the job is running on, -1 while it waits
+	int last_core;//core the job last made progress on, -1 if it has not run yet
 } job_t;
 
 
+PRIQUEUE_DEFINE(job_queue, long long, PRIQUEUE_LESS)
+
+
+/**
+  The state of one scheduler instance.
+*/
+struct _scheduler_t
+{
+	int num_cores;
+	scheme_t active_scheme;
+	job_t **core_jobs;//job running on each core, NULL when idle
+	job_queue_t ready_queue;//jobs waiting for a core, under every scheme but WS
+	priqueue_t *run_queues;//jobs waiting for each core, under WS
+
+	int jobs_finished;
+	long total_waiting_time;
+	long total_turnaround_time;
+	long total_response_time;
+
+	int num_queues;//1 for the global ready queue, num_cores under WS
+	scheduler_queue_stats_t *queue_stats;
+	double *queue_area;//sum over time of each queue's length, up to queue_time
+	int *queue_time;//when each queue's length last changed
+	long migrations;
+	int end_time;//when the last job finished
+};
+
+/**
+  The instance behind scheduler_start_up() and the other functions without
+  a scheduler_t argument.
+*/
+static scheduler_t *default_scheduler;
+
+
+/**
+  Returns the ready queue key of job under the active scheme: the field the
+  scheme orders by, scaled above the arrival time, so a single integer
+  comparison orders jobs and breaks ties by arrival.
+ */
+static long long job_key(scheduler_t *scheduler, job_t *job)
+{
+	long long primary = 0;
+	scheme_t active_scheme = scheduler->active_scheme;
+
+	if (active_scheme == SJF || active_scheme == PSJF)
+		primary = job->remaining_time;
+	else if (active_scheme == PRI || active_scheme == PPRI)
+		primary = job->priority;
+	else if (active_scheme == RR)
+		return 0;//every job ties, so the queue's insertion order decides
+
+	return primary * 4294967296LL + job->arrival_time;
+}
+
+
+/**
+  Brings a running job's remaining time up to date with time.
+ */
+static void update_remaining_time(job_t *job, int time)
+{
+	job->remaining_time -= time - job->last_scheduled_time;
+	job->last_scheduled_time = time;
+}
+
+
+/**
+  Orders the jobs of a WS run queue by arrival.
+ */
+static int compare_arrival(const void *a, const void *b)
+{
+	const job_t *job_a = a, *job_b = b;
+	return (job_a->arrival_time > job_b->arrival_time) - (job_a->arrival_time < job_b->arrival_time);
+}
+
+
+static int queue_length(scheduler_t *scheduler, int queue)
+{
+	if (scheduler->active_scheme == WS)
+		return priqueue_size(&scheduler->run_queues[queue]);
+	return job_queue_size(&scheduler->ready_queue);
+}
+
+
+/**
+  Adds the time since queue last changed length to its statistics; called
+  before every change.
+ */
+static void account_queue(scheduler_t *scheduler, int queue, int time)
+{
+	scheduler->queue_area[queue] += (double)queue_length(scheduler, queue) * (time - scheduler->queue_time[queue]);
+	scheduler->queue_time[queue] = time;
+}
+
+
+/**
+  Puts job on queue, which is 0 for the global ready queue.
+ */
+static void enqueue_job(scheduler_t *scheduler, int queue, job_t *job, int time)
+{
+	account_queue(scheduler, queue, time);
+
+	if (scheduler->active_scheme == WS)
+		priqueue_offer(&scheduler->run_queues[queue], job);
+	else
+		job_queue_offer(&scheduler->ready_queue, job_key(scheduler, job), job);
+
+	if (queue_length(scheduler, queue) > scheduler->queue_stats[queue].max_length)
+		scheduler->queue_stats[queue].max_length = queue_length(scheduler, queue);
+}
+
+
+/**
+  Takes the first job off queue, or NULL if it is empty.
+ */
+static job_t *dequeue_job(scheduler_t *scheduler, int queue, int time)
+{
+	account_queue(scheduler, queue, time);
+
+	if (scheduler->active_scheme == WS)
+		return priqueue_poll(&scheduler->run_queues[queue]);
+	return job_queue_poll(&scheduler->ready_queue);
+}
+
+
+/**
+  Under WS, takes a job for the idle core_id from the longest run queue
+  (the lowest core id among equals). The thief takes the job that queue
+  would have run last, so the victim keeps the work it is about to start.
+
+  @return the stolen job, or NULL if every run queue is empty
+ */
+static job_t *steal_job(scheduler_t *scheduler, int core_id, int time)
+{
+	int i, victim = -1;
+
+	for (i = 0; i < scheduler->num_cores; i++)
+		if (priqueue_size(&scheduler->run_queues[i]) > 0 &&
+				(victim == -1 || priqueue_size(&scheduler->run_queues[i]) > priqueue_size(&scheduler->run_queues[victim])))
+			victim = i;
+
+	if (victim == -1)
+		return NULL;
+
+	account_queue(scheduler, victim, time);
+	scheduler->queue_stats[core_id].steals++;
+	scheduler->queue_stats[victim].stolen++;
+	return priqueue_remove_at(&scheduler->run_queues[victim], priqueue_size(&scheduler->run_queues[victim]) - 1);
+}
+
+
+static void run_job(scheduler_t *scheduler, job_t *job, int core_id, int time)
+{
+	if (job->last_core != -1 && job->last_core != core_id)
+		scheduler->migrations++;
+
+	job->core_id = core_id;
+	job->last_scheduled_time = time;
+	if (job->first_run_time == -1)
+		job->first_run_time = time;
+
+	scheduler->core_jobs[core_id] = job;
+}
+
+
+/**
+  Takes job off its core and puts it back in the ready queue, or under WS
+  in the run queue of the core it was taken off.
+ */
+static void suspend_job(scheduler_t *scheduler, job_t *job, int time)
+{
+	int queue = (scheduler->active_scheme == WS) ? job->core_id : 0;
+
+	if (job->last_scheduled_time < time)
+		job->last_core = job->core_id;
+	update_remaining_time(job, time);
+
+	//a job preempted in the same time unit it was scheduled never actually ran
+	if (job->first_run_time == time)
+		job->first_run_time = -1;
+
+	scheduler->core_jobs[job->core_id] = NULL;
+	job->core_id = -1;
+	enqueue_job(scheduler, queue, job, time);
+}
+
+
+/**
+  Schedules the next waiting job, if any, on core_id.
+ */
+static int dispatch_next(scheduler_t *scheduler, int core_id, int time)
+{
+	job_t *job;
+
+	if (scheduler->active_scheme == WS)
+	{
+		job = dequeue_job(scheduler, core_id, time);
+		if (job == NULL)
+			job = steal_job(scheduler, core_id, time);
+	}
+	else
+		job = dequeue_job(scheduler, 0, time);
+
+	if (job == NULL)
+	{
+		scheduler->core_jobs[core_id] = NULL;
+		return -1;
+	}
+
+	run_job(scheduler, job, core_id, time);
+	return job->job_number;
+}
+
+
+/**
+  Creates a scheduler instance, independent of every other instance.
+
+  The caller keeps the RR quantum itself and calls
+  scheduler_quantum_expired_r() when it runs out, so no quantum is given
+  here.
+
+  @param cores the number of cores that is available by the scheduler, a positive number
+  @param scheme the scheduling scheme that should be used
+  @return the new scheduler, to be freed with scheduler_destroy()
+  @return NULL if memory could not be allocated
+*/
+scheduler_t *scheduler_create(int cores, scheme_t scheme)
+{
+	scheduler_t *scheduler = calloc(1, sizeof(scheduler_t));
+	if (scheduler == NULL)
+		return NULL;
+
+	scheduler->num_cores = cores;
+	scheduler->active_scheme = scheme;
+	scheduler->num_queues = (scheme == WS) ? cores : 1;
+	scheduler->core_jobs = calloc(cores, sizeof(job_t *));
+	scheduler->queue_stats = calloc(scheduler->num_queues, sizeof(scheduler_queue_stats_t));
+	scheduler->queue_area = calloc(scheduler->num_queues, sizeof(double));
+	scheduler->queue_time = calloc(scheduler->num_queues, sizeof(int));
+	if (scheme == WS)
+		scheduler->run_queues = malloc(cores * sizeof(priqueue_t));
+
+	if (!scheduler->core_jobs || !scheduler->queue_stats || !scheduler->queue_area || !scheduler->queue_time ||
+			(scheme == WS && !scheduler->run_queues))
+	{
+		free(scheduler->core_jobs);
+		free(scheduler->queue_stats);
+		free(scheduler->queue_area);
+		free(scheduler->queue_time);
+		free(scheduler->run_queues);
+		free(scheduler);
+		return NULL;
+	}
+
+	job_queue_init(&scheduler->ready_queue);
+	if (scheme == WS)
+	{
+		int i;
+		for (i = 0; i < cores; i++)
+			priqueue_init_backend(&scheduler->run_queues[i], compare_arrival, PRIQUEUE_TREE);
+	}
+
+	return scheduler;
+}
+
+
 /**
   Initalizes the scheduler.
  
@@ -30,11 +305,80 @@ typedef struct _job_t
     - You may assume that scheme is a valid scheduling scheme.
 
   @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
-  @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
+  @param scheme  the scheduling scheme that should be used. This value will be one of the seven enum values of scheme_t
 */
 void scheduler_start_up(int cores, scheme_t scheme)
 {
+	default_scheduler = scheduler_create(cores, scheme);
+}
+
+
+/**
+  Called when a new job arrives at scheduler. See scheduler_new_job().
 
+  @param scheduler the scheduler instance the job arrives at
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+ */
+int scheduler_new_job_r(scheduler_t *scheduler, int job_number, int time, int running_time, int priority)
+{
+	job_t *job = malloc(sizeof(job_t));
+	job->job_number = job_number;
+	job->arrival_time = time;
+	job->running_time = running_time;
+	job->priority = priority;
+	job->remaining_time = running_time;
+	job->last_scheduled_time = time;
+	job->first_run_time = -1;
+	job->core_id = -1;
+	job->last_core = -1;
+
+	int i;
+	for (i = 0; i < scheduler->num_cores; i++)
+	{
+		if (scheduler->core_jobs[i] == NULL)
+		{
+			run_job(scheduler, job, i, time);
+			return i;
+		}
+	}
+
+	if (scheduler->active_scheme == PSJF || scheduler->active_scheme == PPRI)
+	{
+		//find the running job that would be scheduled last; on ties, the one that arrived latest
+		job_t *victim = NULL;
+		for (i = 0; i < scheduler->num_cores; i++)
+		{
+			job_t *running = scheduler->core_jobs[i];
+			if (scheduler->active_scheme == PSJF)
+				update_remaining_time(running, time);
+
+			if (victim == NULL || job_key(scheduler, running) > job_key(scheduler, victim))
+				victim = running;
+		}
+
+		if (job_key(scheduler, job) < job_key(scheduler, victim))
+		{
+			int core_id = victim->core_id;
+			suspend_job(scheduler, victim, time);
+			run_job(scheduler, job, core_id, time);
+			return core_id;
+		}
+	}
+
+	//under WS the job waits on the core with the shortest run queue
+	int queue = 0;
+	if (scheduler->active_scheme == WS)
+		for (i = 1; i < scheduler->num_cores; i++)
+			if (priqueue_size(&scheduler->run_queues[i]) < priqueue_size(&scheduler->run_queues[queue]))
+				queue = i;
+
+	enqueue_job(scheduler, queue, job, time);
+	return -1;
 }
 
 
@@ -60,7 +404,38 @@ void scheduler_start_up(int cores, scheme_t scheme)
  */
 int scheduler_new_job(int job_number, int time, int running_time, int priority)
 {
-	return -1;
+	return scheduler_new_job_r(default_scheduler, job_number, time, running_time, priority);
+}
+
+
+/**
+  Called when a job of scheduler has completed execution. See
+  scheduler_job_finished().
+
+  @param scheduler the scheduler instance running the job
+  @param core_id the zero-based index of the core where the job was located.
+  @param job_number a globally unique identification number of the job.
+         The job is found through core_id; job_number must name the job
+         running there, which is only checked by an assert.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled to run on core core_id
+  @return -1 if core should remain idle.
+ */
+int scheduler_job_finished_r(scheduler_t *scheduler, int core_id, int job_number, int time)
+{
+	job_t *job = scheduler->core_jobs[core_id];
+
+	assert(job != NULL && job->job_number == job_number);
+	(void)job_number;
+
+	scheduler->jobs_finished++;
+	scheduler->total_turnaround_time += time - job->arrival_time;
+	scheduler->total_waiting_time += time - job->arrival_time - job->running_time;
+	scheduler->total_response_time += job->first_run_time - job->arrival_time;
+	scheduler->end_time = time;
+
+	free(job);
+	return dispatch_next(scheduler, core_id, time);
 }
 
 
@@ -80,7 +455,27 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
  */
 int scheduler_job_finished(int core_id, int job_number, int time)
 {
-	return -1;
+	return scheduler_job_finished_r(default_scheduler, core_id, job_number, time);
+}
+
+
+/**
+  When the scheme of scheduler is RR, called when the quantum timer has
+  expired on a core. See scheduler_quantum_expired().
+
+  @param scheduler the scheduler instance running the core
+  @param core_id the zero-based index of the core where the quantum has expired.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled on core core_id
+  @return -1 if core should remain idle
+ */
+int scheduler_quantum_expired_r(scheduler_t *scheduler, int core_id, int time)
+{
+	job_t *job = scheduler->core_jobs[core_id];
+	if (job != NULL)
+		suspend_job(scheduler, job, time);
+
+	return dispatch_next(scheduler, core_id, time);
 }
 
 
@@ -99,7 +494,22 @@ int scheduler_job_finished(int core_id, int job_number, int time)
  */
 int scheduler_quantum_expired(int core_id, int time)
 {
-	return -1;
+	return scheduler_quantum_expired_r(default_scheduler, core_id, time);
+}
+
+
+/**
+  Returns the average waiting time of all jobs scheduler has finished.
+
+  @param scheduler the scheduler instance
+  @return the average waiting time of the jobs finished so far, 0 if none has finished.
+ */
+float scheduler_average_waiting_time_r(scheduler_t *scheduler)
+{
+	if (scheduler->jobs_finished == 0)
+		return 0.0;
+
+	return (float)scheduler->total_waiting_time / scheduler->jobs_finished;
 }
 
 
@@ -112,7 +522,22 @@ int scheduler_quantum_expired(int core_id, int time)
  */
 float scheduler_average_waiting_time()
 {
-	return 0.0;
+	return scheduler_average_waiting_time_r(default_scheduler);
+}
+
+
+/**
+  Returns the average turnaround time of all jobs scheduler has finished.
+
+  @param scheduler the scheduler instance
+  @return the average turnaround time of the jobs finished so far, 0 if none has finished.
+ */
+float scheduler_average_turnaround_time_r(scheduler_t *scheduler)
+{
+	if (scheduler->jobs_finished == 0)
+		return 0.0;
+
+	return (float)scheduler->total_turnaround_time / scheduler->jobs_finished;
 }
 
 
@@ -125,7 +550,22 @@ float scheduler_average_waiting_time()
  */
 float scheduler_average_turnaround_time()
 {
-	return 0.0;
+	return scheduler_average_turnaround_time_r(default_scheduler);
+}
+
+
+/**
+  Returns the average response time of all jobs scheduler has finished.
+
+  @param scheduler the scheduler instance
+  @return the average response time of the jobs finished so far, 0 if none has finished.
+ */
+float scheduler_average_response_time_r(scheduler_t *scheduler)
+{
+	if (scheduler->jobs_finished == 0)
+		return 0.0;
+
+	return (float)scheduler->total_response_time / scheduler->jobs_finished;
 }
 
 
@@ -138,7 +578,42 @@ float scheduler_average_turnaround_time()
  */
 float scheduler_average_response_time()
 {
-	return 0.0;
+	return scheduler_average_response_time_r(default_scheduler);
+}
+
+
+/**
+  Frees scheduler and every job it still holds.
+
+  @param scheduler the scheduler instance, from scheduler_create()
+*/
+void scheduler_destroy(scheduler_t *scheduler)
+{
+	int i;
+	for (i = 0; i < scheduler->num_cores; i++)
+		free(scheduler->core_jobs[i]);
+	free(scheduler->core_jobs);
+
+	job_t *job;
+	while ((job = job_queue_poll(&scheduler->ready_queue)) != NULL)
+		free(job);
+	job_queue_destroy(&scheduler->ready_queue);
+
+	if (scheduler->active_scheme == WS)
+	{
+		for (i = 0; i < scheduler->num_cores; i++)
+		{
+			while ((job = priqueue_poll(&scheduler->run_queues[i])) != NULL)
+				free(job);
+			priqueue_destroy(&scheduler->run_queues[i]);
+		}
+		free(scheduler->run_queues);
+	}
+
+	free(scheduler->queue_stats);
+	free(scheduler->queue_area);
+	free(scheduler->queue_time);
+	free(scheduler);
 }
 
 
@@ -150,7 +625,15 @@ float scheduler_average_response_time()
 */
 void scheduler_clean_up()
 {
+	scheduler_destroy(default_scheduler);
+	default_scheduler = NULL;
+}
 
+
+static void show_job(void *value, void *ctx)
+{
+	job_t *job = value;
+	fprintf((FILE *)ctx, "%d(%d) ", job->job_number, job->core_id);
 }
 
 
@@ -167,5 +650,70 @@ void scheduler_clean_up()
  */
 void scheduler_show_queue()
 {
+	scheduler_show_queue_r(default_scheduler, stdout);
+}
+
+
+/**
+  Prints the jobs of scheduler, running ones first, then those waiting in
+  the order they are to be scheduled. See scheduler_show_queue().
 
+  @param scheduler the scheduler instance
+  @param out the stream to print to
+ */
+void scheduler_show_queue_r(scheduler_t *scheduler, FILE *out)
+{
+	int i;
+	for (i = 0; i < scheduler->num_cores; i++)
+		if (scheduler->core_jobs[i] != NULL)
+			show_job(scheduler->core_jobs[i], out);
+
+	if (scheduler->active_scheme == WS)
+		for (i = 0; i < scheduler->num_cores; i++)
+			priqueue_foreach(&scheduler->run_queues[i], show_job, out);
+	else
+		job_queue_foreach(&scheduler->ready_queue, show_job, out);
+}
+
+
+/**
+  Returns the number of ready queues of scheduler: one per core under WS,
+  a single shared one under every other scheme.
+
+  @param scheduler the scheduler instance
+  @return the number of ready queues
+ */
+int scheduler_queue_count_r(scheduler_t *scheduler)
+{
+	return scheduler->num_queues;
+}
+
+
+/**
+  Reports the length and steal counters of one ready queue. The mean
+  length is averaged over the time from 0 until the last job finished.
+
+  @param scheduler the scheduler instance
+  @param queue the zero-based index of the queue, which under WS is also its core's id
+  @param stats set to the queue's counters
+ */
+void scheduler_queue_stats_r(scheduler_t *scheduler, int queue, scheduler_queue_stats_t *stats)
+{
+	account_queue(scheduler, queue, scheduler->end_time);
+
+	*stats = scheduler->queue_stats[queue];
+	stats->mean_length = (scheduler->end_time > 0) ? scheduler->queue_area[queue] / scheduler->end_time : 0.0;
+}
+
+
+/**
+  Returns how many times a job that had run on one core was later run on
+  another.
+
+  @param scheduler the scheduler instance
+  @return the number of migrations so far
+ */
+long scheduler_migrations_r(scheduler_t *scheduler)
+{
+	return scheduler->migrations;
 }
@@ -4,10 +4,12 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include <stdio.h>
+
 /**
   Constants which represent the different scheduling algorithms
 */
-typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
+typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR, WS} scheme_t;
 
 void  scheduler_start_up               (int cores, scheme_t scheme);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
@@ -20,4 +22,38 @@ void  scheduler_clean_up               ();
 
 void  scheduler_show_queue             ();
 
+/**
+  A scheduler instance. The functions above act on one default instance;
+  the _r functions below take the instance, so any number of schedulers
+  can run side by side, one per thread.
+*/
+typedef struct _scheduler_t scheduler_t;
+
+/**
+  Load balance counters of one ready queue. WS keeps a run queue per core,
+  served in arrival order, and a core whose queue runs dry steals from the
+  longest one; every other scheme has a single queue shared by all cores.
+*/
+typedef struct _scheduler_queue_stats_t
+{
+	double mean_length;//number of waiting jobs, averaged over time
+	int max_length;
+	long steals;//jobs this queue's core took from other queues
+	long stolen;//jobs other cores took from this queue
+} scheduler_queue_stats_t;
+
+scheduler_t *scheduler_create          (int cores, scheme_t scheme);
+int   scheduler_new_job_r              (scheduler_t *scheduler, int job_number, int time, int running_time, int priority);
+int   scheduler_job_finished_r         (scheduler_t *scheduler, int core_id, int job_number, int time);
+int   scheduler_quantum_expired_r      (scheduler_t *scheduler, int core_id, int time);
+float scheduler_average_turnaround_time_r(scheduler_t *scheduler);
+float scheduler_average_waiting_time_r (scheduler_t *scheduler);
+float scheduler_average_response_time_r(scheduler_t *scheduler);
+void  scheduler_show_queue_r           (scheduler_t *scheduler, FILE *out);
+void  scheduler_destroy                (scheduler_t *scheduler);
+
+int   scheduler_queue_count_r          (scheduler_t *scheduler);
+void  scheduler_queue_stats_r          (scheduler_t *scheduler, int queue, scheduler_queue_stats_t *stats);
+long  scheduler_migrations_r           (scheduler_t *scheduler);
+
 #endif /* LIBSCHEDULER_H_ */
@@ -0,0 +1,952 @@
+/** @file libsimulator.c
+
+  The simulation loop of the scheduler simulator, driving libscheduler
+  over a workload one time unit (or, event-driven, one event) at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "libsimulator.h"
+
+
+typedef struct _simulator_job_list_t
+{
+	int job_id, arrival_time, run_time, priority;
+	int core_id, arrived;
+} simulator_job_list_t;
+
+/*
+ * The timing diagram of one core, kept as runs of consecutive time units
+ * spent on the same job (job_id -1 while idle).  Extending the diagram is
+ * O(1); the text is only produced when it is printed.
+ */
+typedef struct _diagram_segment_t
+{
+	int job_id, start, end;
+} diagram_segment_t;
+
+typedef struct _core_diagram_t
+{
+	diagram_segment_t *segments;
+	int size, capacity;
+} core_diagram_t;
+
+typedef struct _arrival_t
+{
+	int arrival_time, slot;
+} arrival_t;
+
+static int compare_arrivals(const void *a, const void *b)
+{
+	const arrival_t *arrival_a = a, *arrival_b = b;
+
+	if (arrival_a->arrival_time != arrival_b->arrival_time)
+		return (arrival_a->arrival_time < arrival_b->arrival_time) ? -1 : 1;
+	return arrival_a->slot - arrival_b->slot;
+}
+
+/*
+ * Records that the core ran job_id (-1 for idle) from time unit start up to,
+ * but not including, end.  Returns 0 if memory could not be allocated.
+ */
+static int diagram_append(core_diagram_t *diagram, int job_id, int start, int end)
+{
+	if (diagram->size > 0)
+	{
+		diagram_segment_t *last = &diagram->segments[diagram->size - 1];
+		if (last->job_id == job_id && last->end == start)
+		{
+			last->end = end;
+			return 1;
+		}
+	}
+
+	if (diagram->size == diagram->capacity)
+	{
+		int capacity = (diagram->capacity > 0) ? diagram->capacity * 2 : 16;
+		diagram_segment_t *segments = realloc(diagram->segments, capacity * sizeof(diagram_segment_t));
+		if (segments == NULL)
+			return 0;
+
+		diagram->segments = segments;
+		diagram->capacity = capacity;
+	}
+
+	diagram->segments[diagram->size].job_id = job_id;
+	diagram->segments[diagram->size].start = start;
+	diagram->segments[diagram->size].end = end;
+	diagram->size++;
+	return 1;
+}
+
+static void print_diagram(FILE *out, int core_id, core_diagram_t *diagram)
+{
+	int i, t;
+	char label[16];
+
+	fprintf(out, "  Core %2d: ", core_id);
+
+	for (i = 0; i < diagram->size; i++)
+	{
+		int job_id = diagram->segments[i].job_id;
+
+		if (job_id == -1)
+			strcpy(label, "-");
+		else if (job_id < 10)
+			sprintf(label, "%d", job_id);
+		else if (job_id < 10 + 26)
+			sprintf(label, "%c", job_id - 10 + 'a');
+		else if (job_id < 10 + 26 + 26)
+			sprintf(label, "%c", job_id - 10 - 26 + 'A');
+		else
+			snprintf(label, sizeof(label), "(%d)", job_id);
+
+		for (t = diagram->segments[i].start; t < diagram->segments[i].end; t++)
+			fputs(label, out);
+	}
+
+	fprintf(out, "\n");
+}
+
+
+/*
+ * Table from a job id to the job's index in jobs[].  A loaded workload has
+ * ids 0..n-1, so it is a plain array indexed by id.  When streaming, it is
+ * an open-addressing hash holding only the jobs still in jobs[], so it
+ * stays as small as the set of live jobs even for an unbounded trace.
+ */
+typedef struct _job_table_t
+{
+	int *dense;//slot of each job id, -1 once finished; NULL when hashing
+	int dense_size;
+	int *ids;//job id held by each bucket, -1 if the bucket is empty
+	int *slots;
+	int capacity;//always a power of two
+	int shift;//32 - log2(capacity), for Fibonacci hashing
+	int size;
+} job_table_t;
+
+static int job_table_home(job_table_t *table, int job_id)
+{
+	return (int)(((unsigned int)job_id * 2654435769u) >> table->shift);
+}
+
+/*
+ * Returns 0 if memory could not be allocated.
+ */
+static int job_table_init(job_table_t *table, int expected)
+{
+	int i;
+
+	table->dense = NULL;
+	table->dense_size = 0;
+	table->capacity = 16;
+	table->shift = 28;
+	while (table->capacity < 2 * expected)
+	{
+		table->capacity *= 2;
+		table->shift--;
+	}
+
+	table->size = 0;
+	table->ids = malloc(table->capacity * sizeof(int));
+	table->slots = malloc(table->capacity * sizeof(int));
+	if (!table->ids || !table->slots)
+		return 0;
+
+	for (i = 0; i < table->capacity; i++)
+		table->ids[i] = -1;
+	return 1;
+}
+
+static void job_table_destroy(job_table_t *table)
+{
+	free(table->dense);
+	free(table->ids);
+	free(table->slots);
+}
+
+/*
+ * Sets table up as the plain array for the ids 0..count-1, job id i at
+ * index i of jobs[].  Returns 0 if memory could not be allocated.
+ */
+static int job_table_init_dense(job_table_t *table, int count)
+{
+	int i;
+
+	table->ids = NULL;
+	table->slots = NULL;
+	table->capacity = 0;
+	table->size = count;
+	table->dense_size = count;
+	table->dense = malloc((count > 0 ? count : 1) * sizeof(int));
+	if (!table->dense)
+		return 0;
+
+	for (i = 0; i < count; i++)
+		table->dense[i] = i;
+	return 1;
+}
+
+/*
+ * Returns the index in jobs[] of job_id, or -1 if it is not there.
+ */
+static int job_table_get(job_table_t *table, int job_id)
+{
+	if (table->dense)
+		return (job_id >= 0 && job_id < table->dense_size) ? table->dense[job_id] : -1;
+
+	int i = job_table_home(table, job_id);
+
+	while (table->ids[i] != -1)
+	{
+		if (table->ids[i] == job_id)
+			return table->slots[i];
+		i = (i + 1) & (table->capacity - 1);
+	}
+
+	return -1;
+}
+
+/*
+ * Records that job_id is at index slot of jobs[].  Returns 0 if memory
+ * could not be allocated.
+ */
+static int job_table_set(job_table_t *table, int job_id, int slot)
+{
+	int i;
+
+	if (table->dense)
+	{
+		table->dense[job_id] = slot;
+		return 1;
+	}
+
+	if (2 * (table->size + 1) > table->capacity)
+	{
+		job_table_t grown;
+
+		if (!job_table_init(&grown, table->size + 1))
+		{
+			job_table_destroy(&grown);
+			return 0;
+		}
+
+		for (i = 0; i < table->capacity; i++)
+			if (table->ids[i] != -1)
+				job_table_set(&grown, table->ids[i], table->slots[i]);
+
+		free(table->ids);
+		free(table->slots);
+		*table = grown;
+	}
+
+	i = job_table_home(table, job_id);
+	while (table->ids[i] != -1 && table->ids[i] != job_id)
+		i = (i + 1) & (table->capacity - 1);
+
+	if (table->ids[i] == -1)
+		table->size++;
+	table->ids[i] = job_id;
+	table->slots[i] = slot;
+	return 1;
+}
+
+static void job_table_remove(job_table_t *table, int job_id)
+{
+	if (table->dense)
+	{
+		table->dense[job_id] = -1;
+		table->size--;
+		return;
+	}
+
+	int mask = table->capacity - 1;
+	int i = job_table_home(table, job_id), j;
+
+	while (table->ids[i] != job_id)
+	{
+		if (table->ids[i] == -1)
+			return;
+		i = (i + 1) & mask;
+	}
+
+	// Shift later entries of the probe sequence back so none is cut off from its home bucket
+	for (j = (i + 1) & mask; table->ids[j] != -1; j = (j + 1) & mask)
+	{
+		int home = job_table_home(table, table->ids[j]);
+
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			table->ids[i] = table->ids[j];
+			table->slots[i] = table->slots[j];
+			i = j;
+		}
+	}
+
+	table->ids[i] = -1;
+	table->size--;
+}
+
+/*
+ * job_slots maps a job id to its index in jobs[] and core_slot[] maps a
+ * core to the index of the job running on it (-1 when idle), so a job or
+ * core never has to be searched for.
+ */
+static int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, job_table_t *job_slots, int *core_slot)
+{
+	int slot = job_table_get(job_slots, job_id);
+	if (slot == -1 || !jobs[slot].arrived)
+		return 0;
+
+	if (jobs[slot].core_id != -1)
+		core_slot[jobs[slot].core_id] = -1;
+
+	jobs[slot].core_id = core_id;
+	core_slot[core_id] = slot;
+	return 1;
+}
+
+static void print_available_jobs(FILE *out, simulator_job_list_t *jobs, int active_jobs)
+{
+	fprintf(out, "Active jobs are: ");
+
+	int i, first = 1;
+	for (i = 0; i < active_jobs; i++)
+	{
+		if (jobs[i].arrived)
+		{
+			if (first)
+			{
+				fprintf(out, "%d", jobs[i].job_id);
+				first = 0;
+			}
+			else
+				fprintf(out, ", %d", jobs[i].job_id);
+		}
+	}
+
+	if (!first)
+		fprintf(out, "\n");
+}
+
+/*
+ * Returns the next time at which the scheduler has to be called: the
+ * earliest upcoming arrival, completion or (under RR) quantum expiry.
+ * Nothing else can change between now and then, so the simulation can
+ * jump there in one step.
+ */
+static int next_event_time(int time, int next_arrival_time, simulator_job_list_t *jobs, int *core_slot, int cores, int *quantum_clock, int scheme)
+{
+	int i, next = next_arrival_time;
+
+	for (i = 0; i < cores; i++)
+	{
+		if (core_slot[i] != -1)
+		{
+			if (time + jobs[core_slot[i]].run_time < next)
+				next = time + jobs[core_slot[i]].run_time;
+
+			if (scheme == RR && time + quantum_clock[i] < next)
+				next = time + quantum_clock[i];
+		}
+	}
+
+	// Always make progress; a stalled simulation is caught by the sanity check.
+	if (next <= time)
+		next = time + 1;
+
+	return next;
+}
+
+static void print_available_cores(FILE *out, int cores)
+{
+	fprintf(out, "Active cores are: ");
+
+	int i;
+	for (i = 0; i < cores; i++)
+	{
+		if (i == cores - 1)
+			fprintf(out, "%d\n", i);
+		else
+			fprintf(out, "%d, ", i);
+	}
+}
+
+
+/**
+  Runs one simulation over either the count jobs of input or, if trace is
+  not NULL, the jobs streamed from trace, and prints its output to
+  options->out.
+  When streaming, jobs[] only holds the jobs that have arrived and not
+  finished; the rest are read from the trace as they arrive.
+
+  @return 0 on success
+  @return 2 if the input could not be read or memory ran out
+  @return 3 if the scheduler made an invalid decision
+ */
+static int run_simulation(const simulator_options_t *options, const trace_job_t *input, int count, trace_reader_t *trace, simulator_stats_t *stats)
+{
+	int cores = options->cores, scheme = options->scheme, quantum = options->quantum;
+	int event_driven = options->event_driven, verbose = options->verbose, summary = options->summary;
+	int streaming = (trace != NULL);
+	FILE *out = options->out ? options->out : stdout;
+
+	// Released at cleanup, whether the simulation finished or failed
+	int result = 0, k;
+	scheduler_t *scheduler = NULL;
+	int *arrival_order = NULL, *arrival_rank = NULL;
+	job_table_t job_slots = {0};
+	int *core_slot = NULL, *finished_cores = NULL, *quantum_clock = NULL;
+	core_diagram_t *core_timing_diagram = NULL;
+
+	int job_id = 0;
+	int jobs_ct = streaming ? 16 : count;
+	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+
+	if (jobs_ct > 0 && !jobs)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		result = 2;
+		goto cleanup;
+	}
+
+	for (job_id = 0; !streaming && job_id < count; job_id++)
+	{
+		jobs[job_id].job_id = job_id;
+		jobs[job_id].arrival_time = input[job_id].arrival_time;
+		jobs[job_id].run_time = input[job_id].run_time;
+		jobs[job_id].priority = input[job_id].priority;
+		jobs[job_id].core_id = -1;
+		jobs[job_id].arrived = 0;
+	}
+
+	// Look ahead at the first job to arrive
+	trace_job_t job;
+	int status, pending = 0;
+	if (streaming)
+	{
+		status = trace_next(trace, &job);
+		if (status == -1)
+		{
+			result = 2;
+			goto cleanup;
+		}
+		pending = (status == 1);
+	}
+
+
+	if (verbose)
+	{
+		if (streaming)
+			fprintf(out, "Loaded %d core(s) and streaming job(s) using ", cores);
+		else
+			fprintf(out, "Loaded %d core(s) and %d job(s) using ", cores, job_id);
+		if (scheme == FCFS) { fprintf(out, "First Come First Served (FCFS)"); }
+		else if (scheme == SJF) { fprintf(out, "Non-preemptive Shortest Job First (SJF)"); }
+		else if (scheme == PSJF) { fprintf(out, "Preemptive Shortest Job First (PSJF)"); }
+		else if (scheme == PRI) { fprintf(out, "Non-preemptive Priority (PRI)"); }
+		else if (scheme == PPRI) { fprintf(out, "Preemptive Priority (PPRI)"); }
+		else if (scheme == RR) { fprintf(out, "Round Robin (RR) with a quantum of %d", quantum); }
+		else if (scheme == WS) { fprintf(out, "Per-core Work Stealing (WS)"); }
+		fprintf(out, " scheduling...\n\n");
+	}
+
+	scheduler = scheduler_create(cores, scheme);
+	if (scheduler == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		result = 2;
+		goto cleanup;
+	}
+
+	long long scheduler_calls = 0, steps = 0;
+
+
+	int time = 0, i, j;
+	int active_jobs = job_id, jobs_alive = 0;
+
+	/*
+	 * Order the jobs by arrival time once, so each time unit only looks at the
+	 * jobs that actually arrive in it.  arrival_order[] holds the jobs' slots in
+	 * arrival order and arrival_rank[] maps a slot back to its position there;
+	 * both follow a job when step 1 moves it to a new slot.  Inputs that are
+	 * already in arrival order, such as binary traces, skip the sort.
+	 */
+	arrival_order = malloc(job_id * sizeof(int));
+	arrival_rank = malloc(job_id * sizeof(int));
+	int next_arrival = 0;
+
+	if (job_id > 0 && (!arrival_order || !arrival_rank))
+	{
+		fprintf(stderr, "Out of memory.\n");
+		result = 2;
+		goto cleanup;
+	}
+
+	for (i = 0; i < job_id; i++)
+	{
+		arrival_order[i] = i;
+		arrival_rank[i] = i;
+	}
+
+	for (i = 1; i < job_id && jobs[i - 1].arrival_time <= jobs[i].arrival_time; i++)
+		;
+
+	if (i < job_id)
+	{
+		arrival_t *arrivals = malloc(job_id * sizeof(arrival_t));
+
+		if (!arrivals)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			result = 2;
+			goto cleanup;
+		}
+
+		for (i = 0; i < job_id; i++)
+		{
+			arrivals[i].arrival_time = jobs[i].arrival_time;
+			arrivals[i].slot = i;
+		}
+		qsort(arrivals, job_id, sizeof(arrival_t), compare_arrivals);
+
+		for (i = 0; i < job_id; i++)
+		{
+			arrival_order[i] = arrivals[i].slot;
+			arrival_rank[arrivals[i].slot] = i;
+		}
+		free(arrivals);
+	}
+
+	core_slot = malloc(cores * sizeof(int));
+	finished_cores = malloc(cores * sizeof(int));
+	quantum_clock = malloc(cores * sizeof(int));
+	core_timing_diagram = calloc(cores, sizeof(core_diagram_t));
+
+	if (!(streaming ? job_table_init(&job_slots, 16) : job_table_init_dense(&job_slots, job_id)) ||
+			!core_slot || !finished_cores || !quantum_clock || !core_timing_diagram)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		result = 2;
+		goto cleanup;
+	}
+
+	for (i = 0; i < cores; i++)
+	{
+		core_slot[i] = -1;
+		quantum_clock[i] = -1;
+	}
+
+	while (active_jobs > 0 || pending)
+	{
+		steps++;
+
+		if (verbose)
+			fprintf(out, "=== [TIME %d] ===\n", time);
+
+		/*
+		 * 1. Check if any jobs finished in the last time unit.  Only running
+		 *    jobs can finish.  They are handled lowest slot first, the order
+		 *    a scan of jobs[] would meet them in.  That order depends on
+		 *    jobs that have not arrived yet, which a streamed jobs[] does not
+		 *    hold, so there they are handled lowest job id first and the
+		 *    multi-core averages can differ (see simulate_stream).
+		 */
+		int finished_ct = 0;
+		for (j = 0; j < cores; j++)
+			if (core_slot[j] != -1 && jobs[core_slot[j]].run_time == 0)
+				finished_cores[finished_ct++] = j;
+
+		while (finished_ct > 0)
+		{
+			int first = 0;
+			for (j = 1; j < finished_ct; j++)
+				if (streaming ? jobs[core_slot[finished_cores[j]]].job_id < jobs[core_slot[finished_cores[first]]].job_id
+				              : core_slot[finished_cores[j]] < core_slot[finished_cores[first]])
+					first = j;
+
+			i = core_slot[finished_cores[first]];
+			finished_cores[first] = finished_cores[--finished_ct];
+
+			// Notify the scheduler has finished
+			int job_id = jobs[i].job_id;
+			int core_id = jobs[i].core_id;
+			int new_job_id = scheduler_job_finished_r(scheduler, jobs[i].core_id, jobs[i].job_id, time);
+			scheduler_calls++;
+
+			if (scheme == RR)
+				quantum_clock[jobs[i].core_id] = quantum;
+
+			job_table_remove(&job_slots, job_id);
+			core_slot[core_id] = -1;
+
+			// Delete the finished jobs, decrease the number of active jobs
+			if (i != active_jobs - 1)
+			{
+				memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
+				if (!streaming)
+				{
+					arrival_rank[i] = arrival_rank[active_jobs - 1];
+					arrival_order[arrival_rank[i]] = i;
+				}
+				job_table_set(&job_slots, jobs[i].job_id, i);
+				if (jobs[i].core_id != -1)
+					core_slot[jobs[i].core_id] = i;
+			}
+			active_jobs--;
+			jobs_alive--;
+
+			// Set the new job
+			if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, &job_slots, core_slot) )
+			{
+				fprintf(out, "The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_available_jobs(out, jobs, active_jobs);
+				result = 3;
+				goto cleanup;
+			}
+			else if (verbose)
+			{
+				fprintf(out, "Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
+				fprintf(out, "  Queue: "); scheduler_show_queue_r(scheduler, out); fprintf(out, "\n\n");
+			}
+		}
+
+		/*
+		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
+		 */
+		if (active_jobs == 0 && !pending)
+			break;
+
+		/*
+		 * 2. Check of any quantums expired in the last time unit.
+		 */
+		if (scheme == RR)
+		{
+			for (i = 0; i < cores; i++)
+			{
+				if (quantum_clock[i] == 0 && core_slot[i] != -1)
+				{
+					j = core_slot[i];
+
+					// Notify the scheduler the quantum has expired
+					int core_id = jobs[j].core_id;
+					int old_job_id = jobs[j].job_id;
+					int new_job_id = scheduler_quantum_expired_r(scheduler, jobs[j].core_id, time);
+					scheduler_calls++;
+
+					jobs[j].core_id = -1;
+					core_slot[core_id] = -1;
+
+					quantum_clock[core_id] = quantum;
+
+					// Set the new job
+					if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, &job_slots, core_slot) )
+					{
+						fprintf(out, "The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+						print_available_jobs(out, jobs, active_jobs);
+						result = 3;
+						goto cleanup;
+					}
+					else if (verbose)
+					{
+						fprintf(out, "Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
+						fprintf(out, "  Queue: "); scheduler_show_queue_r(scheduler, out); fprintf(out, "\n\n");
+					}
+				}
+			}
+		}
+
+
+		/*
+		 * 3. Check for any new jobs that arrive in this time unit
+		 */
+		while (streaming ? pending && job.arrival_time <= time
+		                 : next_arrival < job_id && jobs[arrival_order[next_arrival]].arrival_time <= time)
+		{
+			if (streaming)
+			{
+				// Append the job to jobs[], then look ahead at the next one
+				if (active_jobs == jobs_ct)
+				{
+					simulator_job_list_t *grown = realloc(jobs, 2 * jobs_ct * sizeof(simulator_job_list_t));
+
+					if (!grown)
+					{
+						fprintf(stderr, "Out of memory.\n");
+						result = 2;
+						goto cleanup;
+					}
+					jobs = grown;
+					jobs_ct *= 2;
+				}
+
+				i = active_jobs++;
+				jobs[i].job_id = job_id++;
+				jobs[i].arrival_time = job.arrival_time;
+				jobs[i].run_time = job.run_time;
+				jobs[i].priority = job.priority;
+				jobs[i].core_id = -1;
+				jobs[i].arrived = 0;
+
+				if (!job_table_set(&job_slots, jobs[i].job_id, i))
+				{
+					fprintf(stderr, "Out of memory.\n");
+					result = 2;
+					goto cleanup;
+				}
+
+				status = trace_next(trace, &job);
+				if (status == -1)
+				{
+					result = 2;
+					goto cleanup;
+				}
+
+				pending = (status == 1);
+				if (pending && job.arrival_time < jobs[i].arrival_time)
+				{
+					fprintf(stderr, "Out-of-order arrival in %s: job %d arrives at time %d, before job %d at time %d.\n",
+							trace->file_name, job_id, job.arrival_time, jobs[i].job_id, jobs[i].arrival_time);
+					result = 2;
+					goto cleanup;
+				}
+			}
+			else
+				i = arrival_order[next_arrival++];
+
+			int new_job_core_id = scheduler_new_job_r(scheduler, jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
+			scheduler_calls++;
+			jobs[i].arrived = 1;
+			jobs_alive++;
+
+			if (new_job_core_id >= 0 && new_job_core_id < cores)
+			{
+				if (verbose)
+				{
+					fprintf(out, "A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
+					fprintf(out, "  Queue: "); scheduler_show_queue_r(scheduler, out); fprintf(out, "\n\n");
+				}
+
+				// Find if anyone is currently using the core.
+				if (core_slot[new_job_core_id] != -1)
+					jobs[core_slot[new_job_core_id]].core_id = -1;
+
+				// Assign the core to the new job
+				jobs[i].core_id = new_job_core_id;
+				core_slot[new_job_core_id] = i;
+
+				if (scheme == RR)
+					quantum_clock[new_job_core_id] = quantum;
+			}
+			else if (new_job_core_id == -1)
+			{
+				if (verbose)
+				{
+					fprintf(out, "A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
+					fprintf(out, "  Queue: "); scheduler_show_queue_r(scheduler, out); fprintf(out, "\n\n");
+				}
+			}
+			else
+			{
+				fprintf(out, "The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
+				print_available_cores(out, cores);
+				result = 3;
+				goto cleanup;
+			}
+		}
+
+
+		/*
+		 * 4. Run the time unit.  In event-driven mode, run every time unit up
+		 *    to the next event at once; nothing can change in between.
+		 */
+		int span = 1;
+		if (event_driven)
+		{
+			int next_arrival_time = INT_MAX;
+			if (streaming ? pending : next_arrival < job_id)
+				next_arrival_time = streaming ? job.arrival_time : jobs[arrival_order[next_arrival]].arrival_time;
+			int next_time = next_event_time(time, next_arrival_time, jobs, core_slot, cores, quantum_clock, scheme);
+			if (next_time != INT_MAX)
+				span = next_time - time;
+		}
+
+		int cores_working = 0;
+
+		for (i = 0; i < cores; i++)
+		{
+			int running_job_id = -1;
+
+			if (core_slot[i] != -1)
+			{
+				simulator_job_list_t *job = &jobs[core_slot[i]];
+
+				assert(job->core_id == i);
+
+				cores_working++;
+				job->run_time -= span;
+				quantum_clock[i] -= span;
+				running_job_id = job->job_id;
+			}
+
+			// The diagram grows with the length of the run; keep it only if it will be printed
+			if (summary && !diagram_append(&core_timing_diagram[i], running_job_id, time, time + span))
+			{
+				fprintf(stderr, "Out of memory.\n");
+				result = 2;
+				goto cleanup;
+			}
+		}
+
+
+		/*
+		 * 5. Print data!
+		 */
+		if (verbose)
+		{
+			fprintf(out, "At the end of time unit %d...\n", time + span - 1);
+
+			for (i = 0; i < cores; i++)
+				print_diagram(out, i, &core_timing_diagram[i]);
+
+			fprintf(out, "\n");
+
+			fprintf(out, "  Queue: ");
+			scheduler_show_queue_r(scheduler, out);
+			fprintf(out, "\n");
+			fprintf(out, "\n");
+		}
+
+
+		/*
+		 * 6. Sanity Checking
+		 *
+		 * - If there's a job alive (needing to be ran) and all CPUs are idle, the scheduler failed to schedule properly.
+		 */
+		if (jobs_alive > 0 && cores_working == 0)
+		{
+			fprintf(out, "All cores are idle and at least one job remains unscheduled.\n");
+			print_available_jobs(out, jobs, active_jobs);
+			result = 3;
+			goto cleanup;
+		}
+
+
+		/*
+		 * 7. Increase time
+		 */
+		time += span;
+	}
+
+
+	if (summary)
+	{
+		fprintf(out, "FINAL TIMING DIAGRAM:\n");
+		for (i = 0; i < cores; i++)
+			print_diagram(out, i, &core_timing_diagram[i]);
+
+		fprintf(out, "\n");
+	}
+	if (!options->quiet)
+	{
+		fprintf(out, "Average Waiting Time: %.2f\n", scheduler_average_waiting_time_r(scheduler));
+		fprintf(out, "Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time_r(scheduler));
+		fprintf(out, "Average Response Time: %.2f\n", scheduler_average_response_time_r(scheduler));
+	}
+
+	if (options->balance)
+	{
+		fprintf(out, "\nLoad balance:\n");
+		for (i = 0; i < scheduler_queue_count_r(scheduler); i++)
+		{
+			scheduler_queue_stats_t queue_stats;
+
+			scheduler_queue_stats_r(scheduler, i, &queue_stats);
+			fprintf(out, "  Queue %2d: mean length %.2f, max length %d, steals %ld, stolen %ld\n",
+					i, queue_stats.mean_length, queue_stats.max_length, queue_stats.steals, queue_stats.stolen);
+		}
+		fprintf(out, "  Migrations: %ld\n", scheduler_migrations_r(scheduler));
+	}
+
+	if (stats)
+	{
+		stats->jobs = job_id;
+		stats->time = time;
+		stats->scheduler_calls = scheduler_calls;
+		stats->steps = steps;
+		stats->average_waiting_time = scheduler_average_waiting_time_r(scheduler);
+		stats->average_turnaround_time = scheduler_average_turnaround_time_r(scheduler);
+		stats->average_response_time = scheduler_average_response_time_r(scheduler);
+		stats->migrations = scheduler_migrations_r(scheduler);
+		stats->steals = 0;
+		for (i = 0; i < scheduler_queue_count_r(scheduler); i++)
+		{
+			scheduler_queue_stats_t queue_stats;
+
+			scheduler_queue_stats_r(scheduler, i, &queue_stats);
+			stats->steals += queue_stats.steals;
+		}
+	}
+
+cleanup:
+	if (scheduler)
+		scheduler_destroy(scheduler);
+	free(quantum_clock);
+	free(arrival_order);
+	free(arrival_rank);
+	job_table_destroy(&job_slots);
+	free(core_slot);
+	free(finished_cores);
+	for (k = 0; core_timing_diagram && k < cores; k++)
+		free(core_timing_diagram[k].segments);
+	free(core_timing_diagram);
+	free(jobs);
+
+	return result;
+}
+
+
+/**
+  Simulates the count jobs of jobs, which are numbered by their index and
+  need not be in arrival order. jobs is only read, so several threads
+  can share one copy of a workload.
+
+  @param options the cores, scheme and output of the simulation
+  @param jobs the workload
+  @param count number of jobs
+  @param stats set to the counters of the simulation if not NULL
+  @return 0 on success, 2 if memory ran out, 3 if the scheduler made an invalid decision
+ */
+int simulate(const simulator_options_t *options, const trace_job_t *jobs, int count, simulator_stats_t *stats)
+{
+	return run_simulation(options, jobs, count, NULL, stats);
+}
+
+
+/**
+  Simulates the jobs of trace, reading each one only when it arrives. The
+  trace must be in arrival order; jobs are numbered in the order read.
+
+  Jobs that finish in the same time unit are handled lowest job id first,
+  whereas simulate handles them in the order of its job slots, which it
+  shuffles as jobs finish. On more than one core the schedulers can then
+  break ties differently, so the averages of a streamed run of a
+  preemptive, RR or WS scheme can differ slightly from simulate's over the
+  same trace. Single-core runs and the other schemes match.
+
+  @param options the cores, scheme and output of the simulation
+  @param trace an open reader, typically from trace_open_stream
+  @param stats set to the counters of the simulation if not NULL
+  @return 0 on success, 2 if the trace could not be read or is out of order, 3 if the scheduler made an invalid decision
+ */
+int simulate_stream(const simulator_options_t *options, trace_reader_t *trace, simulator_stats_t *stats)
+{
+	return run_simulation(options, NULL, 0, trace, stats);
+}
@@ -0,0 +1,45 @@
+/** @file libsimulator.h
+ */
+
+#ifndef LIBSIMULATOR_H_
+#define LIBSIMULATOR_H_
+
+#include "../libscheduler/libscheduler.h"
+#include "../libtrace/libtrace.h"
+
+/**
+  How a simulation is run and what it prints
+*/
+typedef struct _simulator_options_t
+{
+	int cores;
+	scheme_t scheme;
+	int quantum;//time units per quantum, RR only
+	int event_driven;//nonzero to skip straight to the next arrival, completion or quantum expiry
+	int verbose;//nonzero to print every time unit
+	int summary;//nonzero to print the final timing diagram
+	FILE *out;//where the output goes, stdout if NULL
+	int quiet;//nonzero to leave out the averages, e.g. when they are read from stats
+	int balance;//nonzero to print each ready queue's length and steal counts, and the migrations
+} simulator_options_t;
+
+/**
+  Counters of a finished simulation
+*/
+typedef struct _simulator_stats_t
+{
+	int jobs;//jobs simulated
+	int time;//time units simulated
+	long long scheduler_calls;
+	long long steps;//passes through the simulation loop
+	float average_waiting_time;
+	float average_turnaround_time;
+	float average_response_time;
+	long migrations;//jobs resumed on a different core than they last ran on
+	long steals;//jobs taken from another core's run queue, WS only
+} simulator_stats_t;
+
+int simulate       (const simulator_options_t *options, const trace_job_t *jobs, int count, simulator_stats_t *stats);
+int simulate_stream(const simulator_options_t *options, trace_reader_t *trace, simulator_stats_t *stats);
+
+#endif /* LIBSIMULATOR_H_ */
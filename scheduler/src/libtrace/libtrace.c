@@ -0,0 +1,566 @@
+/** @file libtrace.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libtrace.h"
+
+/**
+  Size of the first buffer used when the input is streamed or cannot be
+  mapped.
+*/
+#define TRACE_INITIAL_BUFFER 65536
+
+_Static_assert(sizeof(trace_job_t) == 3 * sizeof(int32_t), "trace_job_t must match the binary record layout");
+_Static_assert(sizeof(trace_header_t) % sizeof(int32_t) == 0, "records must stay aligned after the header");
+
+
+/**
+  Reads all of fd into a malloc'd buffer, for inputs such as pipes that
+  cannot be mapped.
+
+  @return 0 on success, -1 on failure
+ */
+static int read_all(trace_reader_t *reader, int fd)
+{
+	size_t capacity = TRACE_INITIAL_BUFFER;
+	char* data = malloc(capacity);
+	size_t length = 0;
+
+	if (data == NULL)
+		return -1;
+
+	while (1)
+	{
+		if (length == capacity)
+		{
+			char* grown = realloc(data, capacity * 2);
+			if (grown == NULL)
+			{
+				free(data);
+				return -1;
+			}
+			data = grown;
+			capacity *= 2;
+		}
+
+		ssize_t count = read(fd, data + length, capacity - length);
+		if (count < 0)
+		{
+			free(data);
+			return -1;
+		}
+		if (count == 0)
+			break;
+		length += count;
+	}
+
+	reader->data = data;
+	reader->length = length;
+	reader->mapped = 0;
+	return 0;
+}
+
+
+/**
+  Parses a decimal integer, with optional sign and surrounding blanks, from
+  the characters in [p, end).
+
+  @return the first character after the integer and any trailing blanks
+  @return NULL if there is no integer there or it does not fit in an int
+ */
+static const char *scan_int(const char *p, const char *end, int *value)
+{
+	int negative = 0;
+	long long result = 0;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	if (p == end || *p < '0' || *p > '9')
+		return NULL;
+
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		result = result * 10 + (*p - '0');
+		if (result > (long long)INT_MAX + 1)
+			return NULL;
+		p++;
+	}
+
+	if (negative)
+		result = -result;
+	if (result > INT_MAX)
+		return NULL;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+
+	*value = (int)result;
+	return p;
+}
+
+
+static int trace_error(trace_reader_t *reader, const char *message)
+{
+	if (reader->binary)
+		fprintf(stderr, "Illegal trace: %s, record %d: %s.\n", reader->file_name, reader->line, message);
+	else
+		fprintf(stderr, "Illegal file format: %s, line %d: %s.\n", reader->file_name, reader->line, message);
+	return -1;
+}
+
+
+/**
+  Makes at least want bytes available from reader->offset on. Bytes
+  already consumed are discarded first. Only a streamed file reads
+  anything here; a mapped or fully read file already has all its bytes.
+
+  @return 0 once want bytes are available or the file has ended
+  @return -1 on a read error
+ */
+static int stream_fill(trace_reader_t *reader, size_t want)
+{
+	while (reader->fd != -1 && reader->length - reader->offset < want)
+	{
+		if (reader->offset > 0)
+		{
+			memmove(reader->data, reader->data + reader->offset, reader->length - reader->offset);
+			reader->length -= reader->offset;
+			reader->offset = 0;
+		}
+
+		if (reader->length == reader->capacity)
+		{
+			char* grown = realloc(reader->data, reader->capacity * 2);
+			if (grown == NULL)
+				return -1;
+			reader->data = grown;
+			reader->capacity *= 2;
+		}
+
+		ssize_t count = read(reader->fd, reader->data + reader->length, reader->capacity - reader->length);
+		if (count < 0)
+			return -1;
+
+		if (count == 0)
+		{
+			close(reader->fd);
+			reader->fd = -1;
+		}
+		reader->length += count;
+	}
+
+	return 0;
+}
+
+
+/**
+  Finds the end of the line starting at reader->offset, reading more of a
+  streamed file until the line is complete.
+
+  @return the line's '\n', or NULL if it is the last line and has none
+ */
+static const char *stream_line(trace_reader_t *reader)
+{
+	size_t scanned = 0;
+
+	while (1)
+	{
+		size_t available = reader->length - reader->offset;
+		const char* newline = memchr(reader->data + reader->offset + scanned, '\n', available - scanned);
+
+		if (newline != NULL || reader->fd == -1)
+			return newline;
+
+		scanned = available;
+		if (stream_fill(reader, available + 1) != 0)
+			return NULL;
+	}
+}
+
+
+/**
+  Checks the header of a binary trace and skips past it.
+
+  @return 0 on success, -1 if the header does not describe this file
+ */
+static int open_binary(trace_reader_t *reader)
+{
+	trace_header_t header;
+	const char* error = NULL;
+
+	reader->binary = 1;
+	reader->line = 0;
+
+	if (stream_fill(reader, sizeof(trace_header_t)) != 0 || reader->length - reader->offset < sizeof(trace_header_t))
+	{
+		fprintf(stderr, "Illegal trace: %s: truncated header.\n", reader->file_name);
+		return -1;
+	}
+
+	memcpy(&header, reader->data + reader->offset, sizeof(trace_header_t));
+	reader->offset += sizeof(trace_header_t);
+
+	if (header.byte_order != TRACE_BYTE_ORDER)
+		error = "written with a different byte order";
+	else if (header.version != TRACE_VERSION)
+		error = "unsupported version";
+	else if (header.record_size != sizeof(trace_job_t))
+		error = "unsupported record size";
+	else if (header.count > INT_MAX)
+		error = "too many records";
+	else if (reader->fd == -1 && reader->length - reader->offset != header.count * sizeof(trace_job_t))
+		error = "file length does not match the record count";
+
+	if (error != NULL)
+	{
+		fprintf(stderr, "Illegal trace: %s: %s.\n", reader->file_name, error);
+		return -1;
+	}
+
+	reader->rows = (int)header.count;
+	return 0;
+}
+
+
+/**
+  Opens fd for reader: either maps the whole file or, when streaming,
+  keeps it open behind a small buffer. Then detects the format and skips
+  the header.
+
+  @return 0 on success, -1 on failure after printing why
+ */
+static int open_reader(trace_reader_t *reader, const char *file_name, int stream)
+{
+	struct stat st;
+	int fd = open(file_name, O_RDONLY);
+
+	reader->file_name = file_name;
+	reader->data = NULL;
+	reader->length = 0;
+	reader->capacity = 0;
+	reader->offset = 0;
+	reader->fd = -1;
+	reader->mapped = 0;
+	reader->binary = 0;
+	reader->line = 1;
+	reader->rows = -1;
+
+	if (fd == -1)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return -1;
+	}
+
+	if (stream)
+	{
+		reader->data = malloc(TRACE_INITIAL_BUFFER);
+		if (reader->data == NULL)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			close(fd);
+			return -1;
+		}
+		reader->capacity = TRACE_INITIAL_BUFFER;
+		reader->fd = fd;
+	}
+	else
+	{
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		{
+			void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				madvise(data, st.st_size, MADV_SEQUENTIAL);
+				reader->data = data;
+				reader->length = st.st_size;
+				reader->mapped = 1;
+			}
+		}
+
+		if (!reader->mapped && read_all(reader, fd) != 0)
+		{
+			fprintf(stderr, "Unable to read file \"%s\".\n", file_name);
+			close(fd);
+			return -1;
+		}
+		close(fd);
+	}
+
+	if (stream_fill(reader, sizeof(TRACE_MAGIC) - 1) != 0)
+	{
+		fprintf(stderr, "Unable to read file \"%s\".\n", file_name);
+		trace_close(reader);
+		return -1;
+	}
+
+	if (reader->length - reader->offset >= sizeof(TRACE_MAGIC) - 1 &&
+		memcmp(reader->data + reader->offset, TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1) == 0)
+	{
+		if (open_binary(reader) == 0)
+			return 0;
+
+		trace_close(reader);
+		return -1;
+	}
+
+	// Skip the header line
+	const char* newline = stream_line(reader);
+	reader->offset = (newline != NULL) ? (size_t)(newline + 1 - reader->data) : reader->length;
+	return 0;
+}
+
+
+/**
+  Opens a job trace: either a CSV file with one header line followed by
+  one "arrival time,run time,priority" row per job, or a binary trace
+  starting with TRACE_MAGIC. The file is mapped into memory (or read
+  whole, if it cannot be mapped) and its rows are counted, so the caller
+  can size its job array exactly before reading them.
+
+  @param reader the reader to initialize
+  @param file_name path of the trace file
+  @return 0 on success
+  @return -1 if the file could not be opened or read, after printing why
+ */
+int trace_open(trace_reader_t *reader, const char *file_name)
+{
+	if (open_reader(reader, file_name, 0) != 0)
+		return -1;
+
+	if (!reader->binary)
+	{
+		const char* p = reader->data + reader->offset;
+		const char* end = reader->data + reader->length;
+		const char* newline;
+
+		reader->rows = 0;
+		while (p < end && (newline = memchr(p, '\n', end - p)) != NULL)
+		{
+			reader->rows++;
+			p = newline + 1;
+		}
+		if (p < end)
+			reader->rows++;
+	}
+
+	return 0;
+}
+
+
+/**
+  Opens a job trace for streaming. Like trace_open, but the file is read
+  through a small buffer as trace_next asks for rows, so memory use does
+  not depend on the size of the file. Rows are not counted in advance.
+
+  @param reader the reader to initialize
+  @param file_name path of the trace file
+  @return 0 on success
+  @return -1 if the file could not be opened or read, after printing why
+ */
+int trace_open_stream(trace_reader_t *reader, const char *file_name)
+{
+	return open_reader(reader, file_name, 1);
+}
+
+
+/**
+  Returns the number of job rows in the trace.
+
+  @param reader an open reader
+  @return the number of rows after the header, which trace_next never
+          returns more jobs than
+  @return -1 if the rows of a streamed CSV file are not known yet
+ */
+int trace_rows(trace_reader_t *reader)
+{
+	return reader->rows;
+}
+
+
+/**
+  Gives the records of a binary trace in place, without copying or
+  parsing them. The records of a mapped trace stay in the mapping, which
+  is aligned for trace_job_t since the header is a whole number of ints.
+
+  @param reader a reader opened by trace_open on which trace_next has not
+         been called
+  @param jobs receives the records, valid until trace_close; NULL if the
+         trace is a CSV file or is being streamed
+  @return the number of records
+  @return 0 with *jobs NULL if the rows must be read with trace_next
+  @return -1 if a record is invalid, after printing its number
+ */
+int trace_records(trace_reader_t *reader, const trace_job_t **jobs)
+{
+	*jobs = NULL;
+	if (!reader->binary || reader->fd != -1 || reader->line != 0)
+		return 0;
+
+	const trace_job_t* records = (const trace_job_t*)(reader->data + reader->offset);
+	int i;
+
+	for (i = 0; i < reader->rows; i++)
+	{
+		if (records[i].run_time <= 0)
+		{
+			reader->line = i + 1;
+			return trace_error(reader, "the run time must be positive");
+		}
+	}
+
+	*jobs = records;
+	return reader->rows;
+}
+
+
+/**
+  Reads the next job row. Every row must hold exactly three integers
+  separated by commas, and the run time must be positive.
+
+  @param reader an open reader
+  @param job receives the job
+  @return 1 if a job was read
+  @return 0 at the end of the trace
+  @return -1 if the row is malformed, after printing its line number
+ */
+int trace_next(trace_reader_t *reader, trace_job_t *job)
+{
+	if (reader->binary)
+	{
+		if (reader->line == reader->rows)
+			return 0;
+
+		reader->line++;
+		if (stream_fill(reader, sizeof(trace_job_t)) != 0 || reader->length - reader->offset < sizeof(trace_job_t))
+			return trace_error(reader, "truncated record");
+
+		memcpy(job, reader->data + reader->offset, sizeof(trace_job_t));
+		reader->offset += sizeof(trace_job_t);
+
+		if (job->run_time <= 0)
+			return trace_error(reader, "the run time must be positive");
+		return 1;
+	}
+
+	const char* newline = stream_line(reader);
+
+	if (reader->offset >= reader->length)
+		return 0;
+
+	const char* p = reader->data + reader->offset;
+	const char* end = (newline != NULL) ? newline : reader->data + reader->length;
+
+	reader->offset = end - reader->data + (newline != NULL);
+	reader->line++;
+
+	if (end > p && end[-1] == '\r')
+		end--;
+
+	if ((p = scan_int(p, end, &job->arrival_time)) == NULL)
+		return trace_error(reader, "expected an integer arrival time");
+	if (p == end || *p++ != ',')
+		return trace_error(reader, "expected ',' after the arrival time");
+
+	if ((p = scan_int(p, end, &job->run_time)) == NULL)
+		return trace_error(reader, "expected an integer run time");
+	if (p == end || *p++ != ',')
+		return trace_error(reader, "expected ',' after the run time");
+
+	if ((p = scan_int(p, end, &job->priority)) == NULL)
+		return trace_error(reader, "expected an integer priority");
+	if (p != end)
+		return trace_error(reader, "unexpected text after the priority");
+
+	if (job->run_time <= 0)
+		return trace_error(reader, "the run time must be positive");
+
+	return 1;
+}
+
+
+/**
+  Releases the file and buffer held by a reader.
+
+  @param reader a reader initialized by trace_open or trace_open_stream
+ */
+void trace_close(trace_reader_t *reader)
+{
+	if (reader->fd != -1)
+		close(reader->fd);
+
+	if (reader->mapped)
+		munmap(reader->data, reader->length);
+	else
+		free(reader->data);
+
+	reader->data = NULL;
+	reader->length = 0;
+	reader->offset = 0;
+	reader->fd = -1;
+	reader->mapped = 0;
+}
+
+
+/**
+  Writes jobs as a binary trace.
+
+  @param file_name path of the trace to create or replace
+  @param jobs the jobs to store, sorted by arrival time
+  @param count number of jobs
+  @return 0 on success
+  @return -1 if the jobs are out of order or the file could not be
+          written, after printing why
+ */
+int trace_write(const char *file_name, const trace_job_t *jobs, int count)
+{
+	trace_header_t header;
+	int i;
+
+	for (i = 1; i < count; i++)
+	{
+		if (jobs[i].arrival_time < jobs[i - 1].arrival_time)
+		{
+			fprintf(stderr, "Jobs for \"%s\" are not sorted by arrival time.\n", file_name);
+			return -1;
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.byte_order = TRACE_BYTE_ORDER;
+	header.record_size = sizeof(trace_job_t);
+	header.count = count;
+
+	FILE* file = fopen(file_name, "wb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return -1;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+		(count > 0 && fwrite(jobs, sizeof(trace_job_t), count, file) != (size_t)count) ||
+		fclose(file) != 0)
+	{
+		fprintf(stderr, "Unable to write file \"%s\".\n", file_name);
+		return -1;
+	}
+
+	return 0;
+}
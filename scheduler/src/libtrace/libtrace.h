@@ -0,0 +1,75 @@
+/** @file libtrace.h
+ */
+
+#ifndef LIBTRACE_H_
+#define LIBTRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+  Binary trace format. A trace_header_t is followed by count packed
+  trace_job_t records, sorted by arrival time, in the byte order of the
+  machine that wrote them.
+*/
+#define TRACE_MAGIC "SCHEDTRC"
+#define TRACE_VERSION 1
+#define TRACE_BYTE_ORDER 0x01020304
+
+/**
+  One job of a workload trace
+*/
+typedef struct _trace_job_t
+{
+  int arrival_time;
+  int run_time;
+  int priority;
+} trace_job_t;
+
+/**
+  Header of a binary trace
+*/
+typedef struct _trace_header_t
+{
+  char magic[8];//TRACE_MAGIC, without its terminating '\0'
+  uint32_t version;//TRACE_VERSION
+  uint32_t byte_order;//TRACE_BYTE_ORDER as stored by the writer
+  uint32_t record_size;//sizeof(trace_job_t)
+  uint32_t flags;//reserved, 0
+  uint64_t count;//number of records
+} trace_header_t;
+
+/**
+  Reader over a job trace. trace_open maps the whole file into memory;
+  trace_open_stream reads it through a buffer as rows are asked for. Either
+  way trace_next parses one row at a time.
+
+  Once known, rows is an upper bound on the jobs trace_next returns: each
+  call consumes at least one row, so an array of trace_rows() jobs is
+  always large enough to read the whole trace into.
+*/
+typedef struct _trace_reader_t
+{
+  const char* file_name;
+  char* data;//file contents, or the buffered part of a streamed file
+  size_t length;//number of bytes in data
+  size_t capacity;//number of bytes allocated for data when streaming
+  size_t offset;//first byte of the next row
+  int fd;//file being streamed, -1 once it has been read to the end or if not streaming
+  int mapped;//nonzero if data is mmapped, zero if it was read into a buffer
+  int binary;//nonzero for a binary trace, zero for a CSV file
+  int line;//line number of the row last returned by trace_next, or number of records returned
+  int rows;//number of rows in the file, not counting the header, -1 if not known
+} trace_reader_t;
+
+
+int    trace_open (trace_reader_t *reader, const char *file_name);
+int    trace_open_stream(trace_reader_t *reader, const char *file_name);
+int    trace_rows (trace_reader_t *reader);
+int    trace_records(trace_reader_t *reader, const trace_job_t **jobs);
+int    trace_next (trace_reader_t *reader, trace_job_t *job);
+void   trace_close(trace_reader_t *reader);
+
+int    trace_write(const char *file_name, const trace_job_t *jobs, int count);
+
+#endif /* LIBTRACE_H_ */
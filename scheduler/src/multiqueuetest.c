@@ -0,0 +1,348 @@
+/** @file multiqueuetest.c
+
+  Stress and throughput test for the multiqueue.
+
+  - order:      with one shard the multiqueue must poll in exact order
+  - stress:     producer and consumer threads run at once; every element
+                offered must be polled exactly once
+  - throughput: each thread polls an element and offers it back with a
+                larger key (the hold model), against a priqueue_t behind a
+                single mutex as the baseline
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libmultiqueue/libmultiqueue.h"
+
+
+static int failures = 0;
+
+static int compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t next_random(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (uint32_t)(*state >> 32);
+}
+
+/*
+ * Returns the positive number in text, or -1 if text is anything else.
+ */
+static int parse_positive(const char *text)
+{
+	char *end;
+	long value;
+
+	errno = 0;
+	value = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || errno != 0 || value <= 0 || value > INT_MAX)
+		return -1;
+	return (int)value;
+}
+
+
+void test_order()
+{
+	multiqueue_t q;
+	int values[1000], i, previous = -1, count = 0;
+	uint64_t rng = 12345;
+	int *value;
+
+	multiqueue_init(&q, compare_ints, 1);
+	for (i = 0; i < 1000; i++)
+	{
+		values[i] = (int)(next_random(&rng) % 500);
+		multiqueue_offer(&q, &values[i]);
+	}
+
+	while ((value = multiqueue_poll(&q)) != NULL)
+	{
+		if (*value < previous)
+		{
+			printf("FAILED: order: polled %d after %d\n", *value, previous);
+			failures++;
+			break;
+		}
+		previous = *value;
+		count++;
+	}
+
+	printf("order: %d of 1000 elements polled in order (expected 1000)\n", count);
+	if (count != 1000 || multiqueue_size(&q) != 0)
+		failures++;
+	multiqueue_destroy(&q);
+}
+
+
+/*
+ * Shared by the threads of the stress test.
+ */
+typedef struct _stress_t
+{
+	multiqueue_t q;
+	int *values;
+	atomic_char *seen;
+	int per_producer;
+	atomic_int polled;
+	int total;
+	atomic_int duplicates;
+	int producer;//next producer id, under start_lock
+	pthread_mutex_t start_lock;
+} stress_t;
+
+static void *stress_producer(void *arg)
+{
+	stress_t *stress = arg;
+
+	pthread_mutex_lock(&stress->start_lock);
+	int first = stress->producer++ * stress->per_producer, i;
+	pthread_mutex_unlock(&stress->start_lock);
+
+	for (i = first; i < first + stress->per_producer; i++)
+		while (multiqueue_offer(&stress->q, &stress->values[i]) != 0)
+			;
+	return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+	stress_t *stress = arg;
+
+	while (atomic_load(&stress->polled) < stress->total)
+	{
+		int *value = multiqueue_poll(&stress->q);
+		if (value == NULL)
+			continue;
+
+		if (atomic_exchange(&stress->seen[value - stress->values], 1) != 0)
+			atomic_fetch_add(&stress->duplicates, 1);
+		atomic_fetch_add(&stress->polled, 1);
+	}
+	return NULL;
+}
+
+void test_stress(int producers, int consumers, int per_producer)
+{
+	stress_t stress;
+	pthread_t *threads = malloc((producers + consumers) * sizeof(pthread_t));
+	int i, missing = 0;
+	uint64_t rng = 777;
+
+	stress.total = producers * per_producer;
+	stress.per_producer = per_producer;
+	stress.values = malloc(stress.total * sizeof(int));
+	stress.seen = calloc(stress.total, sizeof(atomic_char));
+	stress.producer = 0;
+	atomic_init(&stress.polled, 0);
+	atomic_init(&stress.duplicates, 0);
+	pthread_mutex_init(&stress.start_lock, NULL);
+	multiqueue_init(&stress.q, compare_ints, 2 * (producers + consumers));
+
+	for (i = 0; i < stress.total; i++)
+		stress.values[i] = (int)(next_random(&rng) % 100000);
+
+	for (i = 0; i < producers + consumers; i++)
+		pthread_create(&threads[i], NULL, (i < producers) ? stress_producer : stress_consumer, &stress);
+	for (i = 0; i < producers + consumers; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < stress.total; i++)
+		if (!atomic_load(&stress.seen[i]))
+			missing++;
+
+	printf("stress: %d producer(s), %d consumer(s), %d elements: %d missing, %d duplicated, %d left (expected 0, 0, 0)\n",
+			producers, consumers, stress.total, missing, atomic_load(&stress.duplicates), multiqueue_size(&stress.q));
+	if (missing != 0 || atomic_load(&stress.duplicates) != 0 || multiqueue_size(&stress.q) != 0)
+		failures++;
+
+	multiqueue_destroy(&stress.q);
+	pthread_mutex_destroy(&stress.start_lock);
+	free(stress.values);
+	free(stress.seen);
+	free(threads);
+}
+
+
+/*
+ * Shared by the threads of the throughput test: either a multiqueue, or a
+ * priqueue_t behind one mutex.
+ */
+typedef struct _hold_t
+{
+	multiqueue_t *mq;
+	priqueue_t *q;
+	pthread_mutex_t lock;
+	int ops;//operations per thread
+	atomic_int thread_id;
+} hold_t;
+
+static void *hold_worker(void *arg)
+{
+	hold_t *hold = arg;
+	uint64_t rng = 0x2545F4914F6CDD1DULL * (uint64_t)(atomic_fetch_add(&hold->thread_id, 1) + 1);
+	int i;
+
+	for (i = 0; i < hold->ops; i++)
+	{
+		int *value;
+
+		if (hold->mq)
+			value = multiqueue_poll(hold->mq);
+		else
+		{
+			pthread_mutex_lock(&hold->lock);
+			value = priqueue_poll(hold->q);
+			pthread_mutex_unlock(&hold->lock);
+		}
+
+		if (value == NULL)
+			continue;
+		*value += 1 + (int)(next_random(&rng) % 1000);
+
+		if (hold->mq)
+			multiqueue_offer(hold->mq, value);
+		else
+		{
+			pthread_mutex_lock(&hold->lock);
+			priqueue_offer(hold->q, value);
+			pthread_mutex_unlock(&hold->lock);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Runs the hold model with threads threads over size elements and returns
+ * the operations (poll plus offer) per second.
+ */
+static double run_hold(int use_multiqueue, int threads, int size, int ops)
+{
+	hold_t hold;
+	multiqueue_t mq;
+	priqueue_t q;
+	pthread_t *ids = malloc(threads * sizeof(pthread_t));
+	int *values = malloc(size * sizeof(int));
+	uint64_t rng = 99;
+	int i;
+
+	hold.mq = use_multiqueue ? &mq : NULL;
+	hold.q = use_multiqueue ? NULL : &q;
+	hold.ops = ops;
+	atomic_init(&hold.thread_id, 0);
+	pthread_mutex_init(&hold.lock, NULL);
+
+	if (use_multiqueue)
+		multiqueue_init(&mq, compare_ints, 4 * threads);
+	else
+		priqueue_init_backend(&q, compare_ints, PRIQUEUE_HEAP);
+
+	for (i = 0; i < size; i++)
+	{
+		values[i] = (int)(next_random(&rng) % 1000);
+		if (use_multiqueue)
+			multiqueue_offer(&mq, &values[i]);
+		else
+			priqueue_offer(&q, &values[i]);
+	}
+
+	double start = now_seconds();
+	for (i = 0; i < threads; i++)
+		pthread_create(&ids[i], NULL, hold_worker, &hold);
+	for (i = 0; i < threads; i++)
+		pthread_join(ids[i], NULL);
+	double seconds = now_seconds() - start;
+
+	if (use_multiqueue)
+	{
+		if (multiqueue_size(&mq) != size)
+		{
+			printf("FAILED: throughput: %d elements left of %d\n", multiqueue_size(&mq), size);
+			failures++;
+		}
+		multiqueue_destroy(&mq);
+	}
+	else
+		priqueue_destroy(&q);
+
+	pthread_mutex_destroy(&hold.lock);
+	free(values);
+	free(ids);
+	return (double)threads * ops / seconds;
+}
+
+
+int main(int argc, char **argv)
+{
+	int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN), ops = 200000, size = 10000, threads, c;
+
+	while ((c = getopt(argc, argv, "t:n:s:")) != -1)
+	{
+		switch (c)
+		{
+			case 't':
+				max_threads = parse_positive(optarg);
+				break;
+
+			case 'n':
+				ops = parse_positive(optarg);
+				break;
+
+			case 's':
+				size = parse_positive(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-t <max threads>] [-n <operations per thread>] [-s <queue size>]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (max_threads <= 0 || ops <= 0 || size <= 0)
+	{
+		fprintf(stderr, "Usage: %s [-t <max threads>] [-n <operations per thread>] [-s <queue size>]\n", argv[0]);
+		return 1;
+	}
+
+	if (max_threads < 4)
+		max_threads = 4;
+
+	test_order();
+	test_stress(1, 1, 100000);
+	test_stress(4, 4, 50000);
+	test_stress(max_threads, 2, 20000);
+
+	printf("\nthroughput, hold model on %d elements, %d operations per thread (poll + offer pairs/s):\n", size, ops);
+	printf("%8s %16s %16s\n", "threads", "multiqueue", "mutex priqueue");
+	for (threads = 1; threads <= max_threads; threads *= 2)
+		printf("%8d %16.0f %16.0f\n", threads, run_hold(1, threads, size, ops), run_hold(0, threads, size, ops));
+
+	if (failures > 0)
+	{
+		printf("\n%d check(s) FAILED\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,372 @@
+/** @file pqbench.c
+
+  Microbenchmark for the priority queue backends, driven by the access
+  patterns of the scheduler:
+
+  - hold:    poll the minimum and offer it back with a random increment
+             (the classic hold model of event-set studies)
+  - fifo:    every key equal, poll and offer back (round robin churn)
+  - remove:  remove the element at a random index and offer it back
+             (preemption picking a victim out of the queue)
+  - drain:   fill the queue in bulk and free it with priqueue_destroy
+
+  Each pattern runs against PRIQUEUE_LIST, PRIQUEUE_HEAP, PRIQUEUE_TREE and
+  the PRIQUEUE_DEFINE typed heap at sizes from 10 up to the -n limit. A
+  cell stops early once it exceeds the -t time budget, so slow backends at
+  large sizes report a rate from fewer operations instead of stalling the
+  run. Results are printed as CSV.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/libpriqueue_typed.h"
+
+PRIQUEUE_DEFINE(benchq, int, PRIQUEUE_LESS)
+
+/**
+  Most operations between two checks of the time budget. The interval
+  starts at one and doubles up to this, so even operations that take
+  milliseconds cannot overrun the budget by much.
+*/
+#define PQBENCH_CHECK_EVERY 1024
+
+typedef enum {PATTERN_HOLD = 0, PATTERN_FIFO, PATTERN_REMOVE, PATTERN_DRAIN} pattern_t;
+
+static const char *pattern_names[] = {"hold", "fifo", "remove", "drain"};
+static const char *backend_names[] = {"list", "heap", "tree", "typed"};
+
+/**
+  Index of the typed queue in backend_names, after the priqueue_backend_t values
+*/
+#define BACKEND_TYPED 3
+
+
+/*
+ * Small xorshift generator; the workload only needs to be cheap and
+ * repeatable, not statistically strong.
+ */
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint32_t rng_next()
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (uint32_t)(rng_state >> 32);
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Hardware cache-miss counter for this process, or -1 where perf events
+ * are not available (containers, perf_event_paranoid, other kernels).
+ */
+static int open_cache_counter()
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counter_start(int fd)
+{
+	if (fd != -1)
+	{
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+static long long counter_stop(int fd)
+{
+	long long count = -1;
+
+	if (fd != -1)
+	{
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count))
+			count = -1;
+	}
+	return count;
+}
+
+
+typedef struct _result_t
+{
+	long long ops;
+	double seconds;
+	long long cache_misses;//-1 if not measured
+	double bytes_per_element;
+} result_t;
+
+/*
+ * Runs one pattern on one backend with size elements queued, for at most
+ * ops operations or budget seconds.
+ */
+static result_t run(pattern_t pattern, int backend, int size, long long ops, double budget)
+{
+	result_t result = {0, 0, -1, 0};
+	int *keys = malloc(size * sizeof(int));
+	void **ptrs = malloc(size * sizeof(void *));
+	priqueue_t q;
+	benchq_t tq;
+	int i, counter = open_cache_counter();
+
+	if (!keys || !ptrs)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		exit(2);
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		keys[i] = (pattern == PATTERN_FIFO) ? 0 : (int)(rng_next() % (4u * size));
+		ptrs[i] = &keys[i];
+	}
+
+	if (backend == BACKEND_TYPED)
+	{
+		benchq_init(&tq);
+		benchq_reserve(&tq, size);
+	}
+	else
+	{
+		priqueue_init_backend(&q, compare_ints, backend);
+		priqueue_reserve(&q, size);
+	}
+
+	double start = now_seconds();
+	double deadline = start + budget;
+
+	if (pattern == PATTERN_DRAIN)
+	{
+		// One operation per element: the bulk insert plus its share of the destroy
+		counter_start(counter);
+		if (backend == BACKEND_TYPED)
+		{
+			for (i = 0; i < size; i++)
+				benchq_offer(&tq, keys[i], &keys[i]);
+			result.bytes_per_element = (double)tq.capacity * sizeof(benchq_entry_t) / size;
+			benchq_destroy(&tq);
+		}
+		else
+		{
+			priqueue_offer_bulk(&q, ptrs, size);
+			result.bytes_per_element = ((double)q.pool_size * sizeof(struct node_t) + (double)q.capacity * sizeof(struct node_t *)) / size;
+			priqueue_destroy(&q);
+		}
+		result.cache_misses = counter_stop(counter);
+		result.ops = size;
+		result.seconds = now_seconds() - start;
+	}
+	else
+	{
+		// Fill untimed, then time the steady state
+		if (backend == BACKEND_TYPED)
+		{
+			for (i = 0; i < size; i++)
+				benchq_offer(&tq, keys[i], &keys[i]);
+			result.bytes_per_element = (double)tq.capacity * sizeof(benchq_entry_t) / size;
+		}
+		else
+		{
+			priqueue_offer_bulk(&q, ptrs, size);
+			result.bytes_per_element = ((double)q.pool_size * sizeof(struct node_t) + (double)q.capacity * sizeof(struct node_t *)) / size;
+		}
+
+		long long next_check = 1, check_step = 1;
+
+		start = now_seconds();
+		deadline = start + budget;
+		counter_start(counter);
+
+		while (result.ops < ops)
+		{
+			int *key;
+
+			if (backend == BACKEND_TYPED)
+			{
+				key = benchq_poll(&tq);
+				if (pattern == PATTERN_HOLD)
+					*key += 1 + (int)(rng_next() % (2u * size));
+				benchq_offer(&tq, *key, key);
+			}
+			else
+			{
+				if (pattern == PATTERN_REMOVE)
+					key = priqueue_remove_at(&q, (int)(rng_next() % (unsigned)size));
+				else
+					key = priqueue_poll(&q);
+
+				if (pattern == PATTERN_HOLD)
+					*key += 1 + (int)(rng_next() % (2u * size));
+				priqueue_offer(&q, key);
+			}
+
+			result.ops++;
+			if (result.ops == next_check)
+			{
+				if (now_seconds() > deadline)
+					break;
+				if (check_step < PQBENCH_CHECK_EVERY)
+					check_step *= 2;
+				next_check += check_step;
+			}
+		}
+
+		result.cache_misses = counter_stop(counter);
+		result.seconds = now_seconds() - start;
+
+		if (backend == BACKEND_TYPED)
+			benchq_destroy(&tq);
+		else
+			priqueue_destroy(&q);
+	}
+
+	if (counter != -1)
+		close(counter);
+	free(keys);
+	free(ptrs);
+	return result;
+}
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-n <max size>] [-o <ops per cell>] [-t <seconds per cell>] [-p <pattern>] [-b <backend>]\n", program_name);
+	fprintf(stderr, "  patterns: hold, fifo, remove, drain (default: all)\n");
+	fprintf(stderr, "  backends: list, heap, tree, typed (default: all)\n");
+}
+
+static int find_name(const char **names, int count, const char *name)
+{
+	int i;
+	for (i = 0; i < count; i++)
+		if (strcmp(names[i], name) == 0)
+			return i;
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	long long max_size = 10000000, ops = 1000000;
+	double budget = 1.0;
+	int only_pattern = -1, only_backend = -1, c;
+	char *end;
+
+	while ((c = getopt(argc, argv, "n:o:t:p:b:")) != -1)
+	{
+		switch (c)
+		{
+			// A malformed number is turned into one the range check below rejects
+			case 'n':
+				errno = 0;
+				max_size = strtoll(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || errno != 0)
+					max_size = -1;
+				break;
+
+			case 'o':
+				errno = 0;
+				ops = strtoll(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || errno != 0)
+					ops = -1;
+				break;
+
+			case 't':
+				errno = 0;
+				budget = strtod(optarg, &end);
+				if (end == optarg || *end != '\0' || errno != 0)
+					budget = -1;
+				break;
+
+			case 'p':
+				if ((only_pattern = find_name(pattern_names, 4, optarg)) == -1)
+				{
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'b':
+				if ((only_backend = find_name(backend_names, 4, optarg)) == -1)
+				{
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (max_size < 10 || max_size > 100000000 || ops <= 0 || budget <= 0)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	int pattern, backend;
+	long long size;
+
+	printf("pattern,backend,size,ops,ns_per_op,cache_misses_per_op,bytes_per_element,complete\n");
+
+	for (pattern = 0; pattern < 4; pattern++)
+	{
+		if (only_pattern != -1 && pattern != only_pattern)
+			continue;
+
+		for (size = 10; size <= max_size; size *= 10)
+		{
+			for (backend = 0; backend < 4; backend++)
+			{
+				if (only_backend != -1 && backend != only_backend)
+					continue;
+				if (pattern == PATTERN_REMOVE && backend == BACKEND_TYPED)
+					continue;//the typed queue has no removal by index
+
+				result_t r = run(pattern, backend, (int)size, ops, budget);
+
+				printf("%s,%s,%lld,%lld,%.1f,", pattern_names[pattern], backend_names[backend], size, r.ops, r.seconds * 1e9 / r.ops);
+				if (r.cache_misses >= 0)
+					printf("%.3f", (double)r.cache_misses / r.ops);
+				printf(",%.1f,%d\n", r.bytes_per_element, pattern == PATTERN_DRAIN || r.ops == ops);
+				fflush(stdout);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -5,6 +5,9 @@
 #include <stdlib.h>
 
 #include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/libpriqueue_typed.h"
+
+PRIQUEUE_DEFINE(intq, int, PRIQUEUE_LESS)
 
 int compare1(const void * a, const void * b)
 {
@@ -16,12 +19,29 @@ int compare2(const void * a, const void * b)
 	return ( *(int*)b - *(int*)a );
 }
 
-int main()
+void print_int(void * value, void * ctx)
+{
+	(void)ctx;
+	printf("%d ", *(int*)value);
+}
+
+int compare_first(const void * a, const void * b)
+{
+	return ( ((int*)a)[0] - ((int*)b)[0] );
+}
+
+void test_backend(priqueue_backend_t backend, int indexed)
 {
 	priqueue_t q, q2;
 
-	priqueue_init(&q, compare1);
-	priqueue_init(&q2, compare2);
+	priqueue_init_backend(&q, compare1, backend);
+	priqueue_init_backend(&q2, compare2, backend);
+
+	if (indexed)
+	{
+		priqueue_enable_index(&q);
+		priqueue_enable_index(&q2);
+	}
 
 	/* Pupulate some data... */
 	int *values = malloc(100 * sizeof(int));
@@ -65,10 +85,130 @@ int main()
 		printf("%d ", *((int *)priqueue_at(&q2, i)) );
 	printf("\n");
 
+	priqueue_iter_t it;
+	printf("Elements by iterator (expected 10 13 14 20 30): ");
+	for (priqueue_iter_begin(&q, &it); !priqueue_iter_end(&it); )
+		printf("%d ", *((int *)priqueue_iter_next(&it)) );
+	printf("\n");
+
+	printf("Elements by foreach (expected 30 20 10): ");
+	priqueue_foreach(&q2, print_int, NULL);
+	printf("\n");
+
 	priqueue_destroy(&q2);
 	priqueue_destroy(&q);
 
+	/* Equal priorities must come out in the order they were offered. */
+	int pairs[8][2];
+	priqueue_init_backend(&q, compare_first, backend);
+	for (i = 0; i < 8; i++)
+	{
+		pairs[i][0] = i % 2;
+		pairs[i][1] = i;
+		priqueue_offer(&q, pairs[i]);
+	}
+
+	printf("Ties in offer order (expected 0 2 4 6 1 3 5 7): ");
+	while (priqueue_size(&q) > 0)
+		printf("%d ", ((int *)priqueue_poll(&q))[1]);
+	printf("\n");
+
+	priqueue_destroy(&q);
+
+	/* A bulk offer must break ties exactly like the same individual offers. */
+	void *batch[4];
+	priqueue_init_backend(&q, compare_first, backend);
+	for (i = 0; i < 4; i++)
+	{
+		priqueue_offer(&q, pairs[i]);
+		batch[i] = pairs[i + 4];
+	}
+	priqueue_offer_bulk(&q, batch, 4);
+
+	printf("Bulk ties in offer order (expected 0 2 4 6 1 3 5 7): ");
+	while (priqueue_size(&q) > 0)
+		printf("%d ", ((int *)priqueue_poll(&q))[1]);
+	printf("\n");
+
+	priqueue_destroy(&q);
+
+	/* Handles let an element be re-prioritized or pulled out without a search. */
+	int keys[4] = {40, 10, 30, 20};
+	priqueue_handle_t handles[4];
+	priqueue_init_backend(&q, compare1, backend);
+	for (i = 0; i < 4; i++)
+		handles[i] = priqueue_offer_handle(&q, &keys[i]);
+
+	keys[0] = 5;
+	priqueue_update_handle(&q, handles[0]);
+	priqueue_remove_handle(&q, handles[2]);
+
+	printf("After update and remove by handle (expected 5 10 20): ");
+	for (i = 0; i < priqueue_size(&q); i++)
+		printf("%d ", *((int *)priqueue_at(&q, i)) );
+	printf("\n");
+
+	priqueue_destroy(&q);
+
 	free(values);
+}
+
+int main()
+{
+	printf("== PRIQUEUE_LIST ==\n");
+	test_backend(PRIQUEUE_LIST, 0);
+
+	printf("\n== PRIQUEUE_HEAP ==\n");
+	test_backend(PRIQUEUE_HEAP, 0);
+
+	printf("\n== PRIQUEUE_TREE ==\n");
+	test_backend(PRIQUEUE_TREE, 0);
+
+	printf("\n== PRIQUEUE_LIST with identity index ==\n");
+	test_backend(PRIQUEUE_LIST, 1);
+
+	printf("\n== PRIQUEUE_HEAP with identity index ==\n");
+	test_backend(PRIQUEUE_HEAP, 1);
+
+	printf("\n== PRIQUEUE_TREE with identity index ==\n");
+	test_backend(PRIQUEUE_TREE, 1);
+
+	/* A pre-sized queue should never need to grow its node pool. */
+	priqueue_t q;
+	int values[100], i;
+
+	priqueue_init_capacity(&q, compare1, 100);
+	for (i = 0; i < 100; i++)
+	{
+		values[i] = 99 - i;
+		priqueue_offer(&q, &values[i]);
+	}
+
+	printf("\n== priqueue_init_capacity ==\n");
+	printf("Pool size after 100 offers: %d (expected 100).\n", q.pool_size);
+	printf("Top element: %d (expected 0).\n", *((int *)priqueue_peek(&q)));
+
+	priqueue_destroy(&q);
+
+	/* The generated queue orders by the inline key and keeps ties FIFO. */
+	intq_t tq;
+	int keys[6] = {30, 10, 20, 10, 30, 10};
+
+	intq_init(&tq);
+	for (i = 0; i < 6; i++)
+		intq_offer(&tq, keys[i], &values[i]);
+
+	printf("\n== PRIQUEUE_DEFINE ==\n");
+	printf("Elements by foreach (expected 98 96 94 97 99 95): ");
+	intq_foreach(&tq, print_int, NULL);
+	printf("\n");
+
+	printf("Elements by poll (expected 98 96 94 97 99 95): ");
+	while (intq_size(&tq) > 0)
+		printf("%d ", *((int *)intq_poll(&tq)));
+	printf("\n");
+
+	intq_destroy(&tq);
 
 	return 0;
 }
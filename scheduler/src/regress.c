@@ -0,0 +1,612 @@
+/** @file regress.c
+
+  Regression runner for the example outputs. Every examples/procN-cC-S.out
+  names an input, a core count and a scheme; each input is loaded once and
+  every combination is simulated in parallel, with the output compared in
+  memory against the expected file. A pass/fail matrix is printed, followed
+  by the first difference of each failure.
+
+  By default only the final timing diagram and the averages are compared.
+  With -f the whole log is compared, except the "Queue:" lines, whose
+  format scheduler_show_queue() leaves up to the implementation.
+
+  Each simulation has its own scheduler_t and prints into its own memory
+  stream, so the workers are plain threads sharing the loaded inputs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "libsimulator/libsimulator.h"
+
+
+/*
+ * An input workload, read once and shared by every run over it.
+ */
+typedef struct _input_t
+{
+	int number;//N of procN.csv
+	trace_job_t *jobs;
+	int count;
+} input_t;
+
+/*
+ * One expected output file and the run that checks it.
+ */
+typedef struct _test_t
+{
+	int input_index;//index of the input in inputs[]
+	input_t *input;
+	int cores;
+	char scheme[16];//as spelled in the file name
+	int column;//index of the scheme in columns[]
+	char *expected;//contents of the .out file
+	char *file_name;
+
+	int passed;
+	char detail[512];//why the test failed
+} test_t;
+
+/*
+ * A scheme as spelled in the file names, e.g. "rr4".
+ */
+typedef struct _column_t
+{
+	char name[16];
+	scheme_t scheme;
+	int quantum;
+} column_t;
+
+#define MAX_COLUMNS 32
+
+static column_t columns[MAX_COLUMNS];
+static int column_ct = 0;
+
+
+static double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Reads the whole of file_name into a '\0'-terminated buffer, or returns
+ * NULL.
+ */
+static char *read_file(const char *file_name)
+{
+	FILE *file = fopen(file_name, "r");
+	if (!file)
+		return NULL;
+
+	size_t length = 0, capacity = 4096, n;
+	char *data = malloc(capacity);
+
+	while (data && (n = fread(data + length, 1, capacity - length - 1, file)) > 0)
+	{
+		length += n;
+		if (length + 1 == capacity)
+		{
+			char *grown = realloc(data, capacity * 2);
+			if (!grown)
+			{
+				free(data);
+				data = NULL;
+				break;
+			}
+			data = grown;
+			capacity *= 2;
+		}
+	}
+
+	fclose(file);
+	if (data)
+		data[length] = '\0';
+	return data;
+}
+
+/*
+ * Returns the index in columns[] of the scheme called name, adding it if
+ * it is new, or -1 if name is not a scheme.
+ */
+static int find_column(const char *name)
+{
+	column_t column;
+	int i;
+
+	memset(&column, 0, sizeof(column));
+	if (strlen(name) >= sizeof(column.name))
+		return -1;
+	strcpy(column.name, name);
+
+	if (strcasecmp(name, "FCFS") == 0) { column.scheme = FCFS; }
+	else if (strcasecmp(name, "SJF") == 0) { column.scheme = SJF; }
+	else if (strcasecmp(name, "PSJF") == 0) { column.scheme = PSJF; }
+	else if (strcasecmp(name, "PRI") == 0) { column.scheme = PRI; }
+	else if (strcasecmp(name, "PPRI") == 0) { column.scheme = PPRI; }
+	else if (strcasecmp(name, "WS") == 0) { column.scheme = WS; }
+	else if (strncasecmp(name, "RR", 2) == 0 && atoi(name + 2) > 0)
+	{
+		column.scheme = RR;
+		column.quantum = atoi(name + 2);
+	}
+	else
+		return -1;
+
+	for (i = 0; i < column_ct; i++)
+		if (strcasecmp(columns[i].name, name) == 0)
+			return i;
+
+	if (column_ct == MAX_COLUMNS)
+		return -1;
+	columns[column_ct] = column;
+	return column_ct++;
+}
+
+static int compare_columns(const void *a, const void *b)
+{
+	const column_t *column_a = a, *column_b = b;
+
+	if (column_a->scheme != column_b->scheme)
+		return column_a->scheme - column_b->scheme;
+	return column_a->quantum - column_b->quantum;
+}
+
+static int compare_tests(const void *a, const void *b)
+{
+	const test_t *test_a = a, *test_b = b;
+
+	if (test_a->input->number != test_b->input->number)
+		return test_a->input->number - test_b->input->number;
+	if (test_a->cores != test_b->cores)
+		return test_a->cores - test_b->cores;
+	return test_a->column - test_b->column;
+}
+
+
+/*
+ * Loads directory/procN.csv into input.  The jobs are also written to a
+ * binary trace and read back, which must give the same jobs.  Returns 0 on
+ * success, -1 if the input could not be read, 1 if the round trip differs.
+ * input->jobs is left for the caller to free either way.
+ */
+static int load_input(input_t *input, const char *directory)
+{
+	char file_name[4096], trace_name[] = "/tmp/regress-XXXXXX";
+	trace_reader_t reader;
+	trace_job_t job;
+	int status, fd, i;
+
+	snprintf(file_name, sizeof(file_name), "%s/proc%d.csv", directory, input->number);
+	if (trace_open(&reader, file_name) != 0)
+		return -1;
+
+	input->count = 0;
+	input->jobs = malloc((trace_rows(&reader) + 1) * sizeof(trace_job_t));
+	if (!input->jobs)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		trace_close(&reader);
+		return -1;
+	}
+
+	while ((status = trace_next(&reader, &input->jobs[input->count])) == 1)
+		input->count++;
+	trace_close(&reader);
+	if (status == -1)
+		return -1;
+
+	if ((fd = mkstemp(trace_name)) == -1)
+	{
+		fprintf(stderr, "Unable to create a temporary trace: %s\n", strerror(errno));
+		return -1;
+	}
+	close(fd);
+
+	status = 0;
+	if (trace_write(trace_name, input->jobs, input->count) != 0 || trace_open(&reader, trace_name) != 0)
+		status = -1;
+	else
+	{
+		for (i = 0; status == 0 && trace_next(&reader, &job) == 1; i++)
+			if (i >= input->count || memcmp(&job, &input->jobs[i], sizeof(job)) != 0)
+				status = 1;
+		if (i != input->count)
+			status = 1;
+		trace_close(&reader);
+	}
+
+	unlink(trace_name);
+	return status;
+}
+
+
+/*
+ * Returns the length of the line starting at p, without its '\n'.
+ */
+static int line_length(const char *p)
+{
+	const char *end = strchr(p, '\n');
+	return end ? (int)(end - p) : (int)strlen(p);
+}
+
+/*
+ * Moves p past its line.
+ */
+static const char *next_line(const char *p)
+{
+	const char *end = strchr(p, '\n');
+	return end ? end + 1 : p + strlen(p);
+}
+
+static const char *skip_queue_lines(const char *p, int *line)
+{
+	while (strncmp(p, "  Queue:", 8) == 0)
+	{
+		p = next_line(p);
+		(*line)++;
+	}
+	return p;
+}
+
+/*
+ * Compares the output of a finished test with the expected output.
+ */
+static void check_test(test_t *test, int full, int status, const char *actual)
+{
+	const char *expected = test->expected;
+	int expected_line = 1, actual_line = 1;
+
+	if (status != 0)
+	{
+		test->passed = 0;
+		snprintf(test->detail, sizeof(test->detail), "the simulation failed with status %d", status);
+		return;
+	}
+
+	if (!full)
+	{
+		// Only the summary was printed; line up the expected file with it
+		const char *summary = strstr(expected, "FINAL TIMING DIAGRAM:");
+		if (summary)
+		{
+			for (; expected < summary; expected++)
+				if (*expected == '\n')
+					expected_line++;
+		}
+	}
+
+	while (1)
+	{
+		if (full)
+		{
+			expected = skip_queue_lines(expected, &expected_line);
+			actual = skip_queue_lines(actual, &actual_line);
+		}
+
+		if (*expected == '\0' && *actual == '\0')
+		{
+			test->passed = 1;
+			return;
+		}
+
+		int expected_length = line_length(expected), actual_length = line_length(actual);
+		if (*expected == '\0' || *actual == '\0' || expected_length != actual_length || strncmp(expected, actual, expected_length) != 0)
+			break;
+
+		expected = next_line(expected);
+		actual = next_line(actual);
+		expected_line++;
+		actual_line++;
+	}
+
+	test->passed = 0;
+	snprintf(test->detail, sizeof(test->detail), "line %d: expected \"%.*s\"%s, got \"%.*s\"%s",
+			expected_line,
+			line_length(expected) < 120 ? line_length(expected) : 120, expected, (*expected == '\0') ? " (end of file)" : "",
+			line_length(actual) < 120 ? line_length(actual) : 120, actual, (*actual == '\0') ? " (end of output)" : "");
+}
+
+
+/*
+ * Simulates test into a memory stream and checks what it printed.
+ */
+static void run_test(test_t *test, int full)
+{
+	char *output = NULL;
+	size_t length = 0;
+	FILE *out = open_memstream(&output, &length);
+
+	if (!out)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		exit(2);
+	}
+
+	simulator_options_t options = {
+		.cores = test->cores,
+		.scheme = columns[test->column].scheme,
+		.quantum = columns[test->column].quantum,
+		.verbose = full,
+		.summary = 1,
+		.out = out,
+	};
+	int status = simulate(&options, test->input->jobs, test->input->count, NULL);
+
+	fclose(out);
+	check_test(test, full, status, output);
+	free(output);
+}
+
+/*
+ * The tests shared by the workers, and the next one nobody has taken.
+ */
+typedef struct _work_t
+{
+	test_t *tests;
+	int test_ct;
+	int next;
+	int full;
+	pthread_mutex_t lock;
+} work_t;
+
+static void *worker(void *arg)
+{
+	work_t *work = arg;
+
+	while (1)
+	{
+		pthread_mutex_lock(&work->lock);
+		int i = work->next++;
+		pthread_mutex_unlock(&work->lock);
+
+		if (i >= work->test_ct)
+			return NULL;
+		run_test(&work->tests[i], work->full);
+	}
+}
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-f] [-j <workers>] [<examples directory>]\n", program_name);
+	fprintf(stderr, "  -f  compare the whole log, not just the final timing diagram and averages\n");
+	fprintf(stderr, "  -j  number of simulations to run at once (default: one per online CPU)\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *directory = "examples";
+	int full = 0, workers = (int)sysconf(_SC_NPROCESSORS_ONLN), c, i, j;
+	long value;
+	char *end;
+
+	while ((c = getopt(argc, argv, "fj:")) != -1)
+	{
+		switch (c)
+		{
+			case 'f':
+				full = 1;
+				break;
+
+			case 'j':
+				errno = 0;
+				value = strtol(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || errno != 0 || value <= 0 || value > INT_MAX)
+				{
+					print_usage(argv[0]);
+					return 1;
+				}
+				workers = (int)value;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind == argc - 1)
+		directory = argv[optind];
+	else if (optind != argc)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (workers <= 0)
+		workers = 1;
+
+
+	/*
+	 * Find the expected outputs and load their inputs, each input once.
+	 */
+	DIR *dir = opendir(directory);
+	if (!dir)
+	{
+		fprintf(stderr, "Unable to open %s: %s\n", directory, strerror(errno));
+		return 2;
+	}
+
+	// Released at cleanup, whether the run finished or failed
+	test_t *tests = NULL;
+	input_t *inputs = NULL;
+	pthread_t *threads = NULL;
+	int test_ct = 0, input_ct = 0, failed = 0, passed = 0, result = 2;
+	struct dirent *entry;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		int number, cores, length = 0, column;
+		char scheme[64], file_name[4096];
+
+		if (sscanf(entry->d_name, "proc%d-c%d-%63[^.].out%n", &number, &cores, scheme, &length) != 3 ||
+				length != (int)strlen(entry->d_name) || cores <= 0 || (column = find_column(scheme)) == -1)
+			continue;
+
+		for (i = 0; i < input_ct && inputs[i].number != number; i++)
+			;
+		if (i == input_ct)
+		{
+			input_t *grown = realloc(inputs, (input_ct + 1) * sizeof(input_t));
+			if (!grown)
+			{
+				fprintf(stderr, "Out of memory.\n");
+				goto cleanup;
+			}
+			inputs = grown;
+			inputs[input_ct].number = number;
+			inputs[input_ct].jobs = NULL;
+			input_ct++;
+		}
+
+		snprintf(file_name, sizeof(file_name), "%s/%s", directory, entry->d_name);
+		test_t *grown = realloc(tests, (test_ct + 1) * sizeof(test_t));
+		if (!grown)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			goto cleanup;
+		}
+		tests = grown;
+		memset(&tests[test_ct], 0, sizeof(test_t));
+		tests[test_ct].input_index = i;
+		tests[test_ct].cores = cores;
+		tests[test_ct].column = column;
+		strcpy(tests[test_ct].scheme, columns[column].name);
+		tests[test_ct].file_name = strdup(file_name);
+		tests[test_ct].expected = read_file(file_name);
+		test_ct++;
+
+		if (!tests[test_ct - 1].file_name || !tests[test_ct - 1].expected)
+		{
+			fprintf(stderr, "Unable to read %s\n", file_name);
+			goto cleanup;
+		}
+	}
+	closedir(dir);
+	dir = NULL;
+
+	if (test_ct == 0)
+	{
+		fprintf(stderr, "No procN-cC-scheme.out files in %s\n", directory);
+		goto cleanup;
+	}
+
+	for (i = 0; i < test_ct; i++)
+		tests[i].input = &inputs[tests[i].input_index];
+
+	for (i = 0; i < input_ct; i++)
+	{
+		int status = load_input(&inputs[i], directory);
+		if (status == -1)
+			goto cleanup;
+		if (status == 1)
+		{
+			printf("proc%d.csv differs when loaded from a binary trace\n", inputs[i].number);
+			failed++;
+		}
+	}
+
+	// Sort the schemes for the matrix, then the tests to match
+	qsort(columns, column_ct, sizeof(column_t), compare_columns);
+	for (i = 0; i < test_ct; i++)
+		tests[i].column = find_column(tests[i].scheme);
+	qsort(tests, test_ct, sizeof(test_t), compare_tests);
+
+
+	/*
+	 * Run the tests, at most workers at a time.
+	 */
+	double start = now_seconds();
+	work_t work = {tests, test_ct, 0, full, PTHREAD_MUTEX_INITIALIZER};
+	int started = 0;
+
+	if (workers > test_ct)
+		workers = test_ct;
+	threads = malloc(workers * sizeof(pthread_t));
+
+	/*
+	 * If a worker cannot be started, the ones that were share the tests;
+	 * with none at all, this thread runs them.
+	 */
+	while (threads && started < workers && pthread_create(&threads[started], NULL, worker, &work) == 0)
+		started++;
+	if (started < workers)
+		fprintf(stderr, "Unable to start %d of %d worker threads; continuing with %d.\n", workers - started, workers, started);
+	if (started == 0)
+		worker(&work);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	workers = (started > 0) ? started : 1;
+
+	double seconds = now_seconds() - start;
+
+
+	/*
+	 * Print the matrix, then what went wrong.
+	 */
+	printf("%-16s", "");
+	for (j = 0; j < column_ct; j++)
+		printf(" %-5s", columns[j].name);
+	printf("\n");
+
+	for (i = 0; i < test_ct; i = j)
+	{
+		char label[32];
+		int column = 0;
+
+		snprintf(label, sizeof(label), "proc%d.csv -c %d", tests[i].input->number, tests[i].cores);
+		printf("%-16s", label);
+
+		for (j = i; j < test_ct && tests[j].input == tests[i].input && tests[j].cores == tests[i].cores; j++)
+		{
+			for (; column < tests[j].column; column++)
+				printf(" %-5s", "");
+			printf(" %-5s", tests[j].passed ? "ok" : "FAIL");
+			column++;
+		}
+		printf("\n");
+	}
+	printf("\n");
+
+	for (i = 0; i < test_ct; i++)
+	{
+		if (tests[i].passed)
+			passed++;
+		else
+		{
+			printf("%s: %s\n", tests[i].file_name, tests[i].detail);
+			failed++;
+		}
+	}
+
+	printf("%d of %d passed (%s comparison) in %.2f s with %d worker(s)\n",
+			passed, test_ct, full ? "full log" : "summary", seconds, workers);
+	result = (failed > 0) ? 1 : 0;
+
+cleanup:
+	if (dir)
+		closedir(dir);
+	for (i = 0; i < test_ct; i++)
+	{
+		free(tests[i].expected);
+		free(tests[i].file_name);
+	}
+	for (i = 0; i < input_ct; i++)
+		free(inputs[i].jobs);
+	free(tests);
+	free(inputs);
+	free(threads);
+
+	return result;
+}
@@ -7,125 +7,479 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
 
-#include "libscheduler/libscheduler.h"
+#include "libsimulator/libsimulator.h"
+#include "libexecutor/libexecutor.h"
 
 
-typedef struct _simulator_job_list_t
+double elapsed_seconds(struct timespec *since)
 {
-	int job_id, arrival_time, run_time, priority;
-	int core_id, arrived;
-} simulator_job_list_t;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
 
 void print_usage(char *program_name)
 {
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+	fprintf(stderr, "Usage: %s [-e] [-S] [-q | -Q] [-T] [-L] [-r <quanta>] [-j <workers>] [-x <us>] -c <cores> -s <scheme> <input file>\n", program_name);
 	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
+	fprintf(stderr, "       %s -c 1..64 -s all -r 1..16 examples/proc1.csv\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, ws (per-core run queues with work stealing)\n");
+	fprintf(stderr, "  -e  event-driven: skip straight to the next arrival, completion or quantum expiry\n");
+	fprintf(stderr, "  -S  stream jobs from the input as they arrive; the input must be in arrival order.\n");
+	fprintf(stderr, "      Jobs finishing in the same time unit are handled lowest job id first, so with\n");
+	fprintf(stderr, "      several cores the averages of ppri, rr and ws can differ slightly from a run without -S\n");
+	fprintf(stderr, "  -q  print only the final timing diagram and the averages\n");
+	fprintf(stderr, "  -Q  print only the averages\n");
+	fprintf(stderr, "  -T  print run statistics (scheduler calls, time units, wall time, peak memory) to stderr\n");
+	fprintf(stderr, "  -L  print load balance statistics: each ready queue's length and steals, and the migrations\n");
+	fprintf(stderr, "  -x <us>  execute instead of simulating: one pinned worker thread per core runs <us>\n");
+	fprintf(stderr, "           microseconds of busy work per time unit, and the latencies are measured\n");
 	fprintf(stderr, "\n");
-	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
+	fprintf(stderr, "Sweep: -c and -s also take comma-separated lists, and numbers take A..B ranges.\n");
+	fprintf(stderr, "Several configurations run in parallel over one loaded input and print a CSV table of averages.\n");
+	fprintf(stderr, "  -s all       every scheme; rr, bare or in all, runs once per quantum of -r\n");
+	fprintf(stderr, "  -s rr1..16   RR with each quantum from 1 to 16\n");
+	fprintf(stderr, "  -r <quanta>  quanta for a bare rr, e.g. 1,2,4..8\n");
+	fprintf(stderr, "  -j <workers> simulations to run at once (default: one per online CPU)\n");
 }
 
-int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
+
+/*
+ * Frees the values parse_numbers had collected and returns -1.
+ */
+static int parse_numbers_fail(int **values)
 {
-	int i;
-	for (i = 0; i < active_jobs; i++)
+	free(*values);
+	*values = NULL;
+	return -1;
+}
+
+/*
+ * Parses a comma-separated list of positive numbers and A..B ranges, such
+ * as "1,2,4..8", into a malloc'd array.  Returns the number of values, or
+ * -1 if spec is malformed.
+ */
+int parse_numbers(const char *spec, int **values)
+{
+	int count = 0, capacity = 0;
+	const char *p = spec;
+	char *end;
+
+	*values = NULL;
+	while (1)
 	{
-		if (jobs[i].job_id == job_id && jobs[i].arrived)
+		long first = strtol(p, &end, 10), last;
+		if (end == p || first <= 0 || first > INT_MAX)
+			return parse_numbers_fail(values);
+
+		last = first;
+		p = end;
+		if (strncmp(p, "..", 2) == 0)
 		{
-			jobs[i].core_id = core_id;
-			return 1;
+			last = strtol(p + 2, &end, 10);
+			if (end == p + 2 || last < first || last > INT_MAX)
+				return parse_numbers_fail(values);
+			p = end;
 		}
+
+		if (last - first >= 1000000 - count)
+			return parse_numbers_fail(values);
+
+		for (; first <= last; first++)
+		{
+			if (count == capacity)
+			{
+				capacity = (capacity > 0) ? capacity * 2 : 16;
+				int *grown = realloc(*values, capacity * sizeof(int));
+				if (!grown)
+					return parse_numbers_fail(values);
+				*values = grown;
+			}
+			(*values)[count++] = (int)first;
+		}
+
+		if (*p == '\0')
+			return count;
+		if (*p != ',')
+			return parse_numbers_fail(values);
+		p++;
 	}
+}
 
-	return 0;
+
+/*
+ * Scheme names as given to -s, indexed by scheme_t.
+ */
+static const char *scheme_names[] = {"fcfs", "sjf", "psjf", "pri", "ppri", "rr", "ws"};
+
+
+/*
+ * One configuration of a sweep: its options and, once run, its results.
+ */
+typedef struct _sweep_run_t
+{
+	simulator_options_t options;
+	simulator_stats_t stats;
+	int status;
+} sweep_run_t;
+
+/*
+ * Frees what parse_schemes had allocated when spec turns out to be
+ * invalid, and returns status.
+ */
+static int parse_schemes_fail(char *copy, int *values, int *quanta, sweep_run_t **runs, int status)
+{
+	if (values != quanta)
+		free(values);
+	free(copy);
+	free(*runs);
+	*runs = NULL;
+	return status;
 }
 
-void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
+/*
+ * Appends the (scheme, quantum) pairs named by spec to runs[], for
+ * example "fcfs,rr1..4" or "all".  A bare "rr" takes the quanta of -r.
+ *
+ * Returns the number of pairs, -1 for an unknown scheme, -2 for an RR
+ * without a valid quantum, or -3 if memory ran out.
+ */
+int parse_schemes(const char *spec, int *quanta, int quantum_ct, sweep_run_t **runs)
 {
-	printf("Active jobs are: ");
+	char *copy = strdup(spec), *token, *saveptr;
+	int count = 0, i, j;
+
+	*runs = NULL;
+	if (!copy)
+		return -3;
 
-	int i, first = 1;
-	for (i = 0; i < active_jobs; i++)
+	for (token = strtok_r(copy, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr))
 	{
-		if (jobs[i].arrived)
+		int all = (strcasecmp(token, "all") == 0), *values = quanta, value_ct = quantum_ct;
+		int first = -1, last = -1;
+
+		for (i = 0; i <= WS; i++)
+			if (i != RR && strcasecmp(token, scheme_names[i]) == 0)
+				first = last = i;
+		if (all)
+		{
+			first = 0;
+			last = WS;
+		}
+		else if (first == -1 && strncasecmp(token, "RR", 2) == 0)
+		{
+			first = last = RR;
+			if (token[2] != '\0' && (value_ct = parse_numbers(token + 2, &values)) == -1)
+				return parse_schemes_fail(copy, values, quanta, runs, -2);
+		}
+		else if (first == -1)
+			return parse_schemes_fail(copy, values, quanta, runs, -1);
+
+		if (first <= RR && RR <= last && value_ct == 0)
+			return parse_schemes_fail(copy, values, quanta, runs, -2);
+
+		for (i = first; i <= last; i++)
 		{
-			if (first)
+			for (j = 0; j < ((i == RR) ? value_ct : 1); j++)
 			{
-				printf("%d", jobs[i].job_id);
-				first = 0;
+				sweep_run_t *grown = realloc(*runs, (count + 1) * sizeof(sweep_run_t));
+				if (!grown)
+					return parse_schemes_fail(copy, values, quanta, runs, -3);
+				*runs = grown;
+				memset(&(*runs)[count], 0, sizeof(sweep_run_t));
+				(*runs)[count].options.scheme = i;
+				(*runs)[count].options.quantum = (i == RR) ? values[j] : 0;
+				count++;
 			}
-			else
-				printf(", %d", jobs[i].job_id);
 		}
+
+		if (values != quanta)
+			free(values);
 	}
 
-	if (!first)
-		printf("\n");
+	free(copy);
+	return count;
 }
 
-void print_available_cores(int cores)
+
+/*
+ * Loads the jobs of file_name.  The records of a binary trace are used in
+ * place, straight from the mapped file; the rows of a CSV file are parsed
+ * into a malloc'd array.  Either way, unload_jobs releases them.  Returns
+ * the number of jobs, or -1 if the file could not be read.
+ */
+int load_jobs(const char *file_name, trace_reader_t *trace, const trace_job_t **jobs)
 {
-	printf("Active cores are: ");
+	trace_job_t *parsed;
+	int job_ct = 0, status;
+
+	if (trace_open(trace, file_name) != 0)
+		return -1;
+
+	if ((job_ct = trace_records(trace, jobs)) == -1 || *jobs != NULL)
+	{
+		if (job_ct == -1)
+			trace_close(trace);
+		return job_ct;
+	}
+
+	parsed = malloc(trace_rows(trace) * sizeof(trace_job_t));
 
-	int i;
-	for (i = 0; i < cores; i++)
+	if (trace_rows(trace) > 0 && !parsed)
 	{
-		if (i == cores - 1)
-			printf("%d\n", i);
+		fprintf(stderr, "Out of memory.\n");
+		trace_close(trace);
+		return -1;
+	}
+
+	while ((status = trace_next(trace, &parsed[job_ct])) == 1)
+		job_ct++;
+
+	trace_close(trace);
+	if (status == -1)
+	{
+		free(parsed);
+		return -1;
+	}
+	*jobs = parsed;
+	return job_ct;
+}
+
+/*
+ * Releases the jobs load_jobs gave.
+ */
+void unload_jobs(trace_reader_t *trace, const trace_job_t *jobs)
+{
+	if (!trace->binary)
+		free((trace_job_t *)jobs);
+	trace_close(trace);
+}
+
+
+/*
+ * The configurations shared by the sweep workers, and the next one nobody
+ * has taken.
+ */
+typedef struct _sweep_t
+{
+	sweep_run_t *runs;
+	int run_ct;
+	int next;
+	const trace_job_t *jobs;
+	int job_ct;
+	pthread_mutex_t lock;
+} sweep_t;
+
+void *sweep_worker(void *arg)
+{
+	sweep_t *sweep = arg;
+
+	while (1)
+	{
+		pthread_mutex_lock(&sweep->lock);
+		int i = sweep->next++;
+		pthread_mutex_unlock(&sweep->lock);
+
+		if (i >= sweep->run_ct)
+			return NULL;
+		sweep->runs[i].status = simulate(&sweep->runs[i].options, sweep->jobs, sweep->job_ct, &sweep->runs[i].stats);
+	}
+}
+
+/*
+ * Runs every configuration of runs[] over the jobs of file_name, workers
+ * at a time, and prints one CSV row of averages per configuration.
+ */
+int run_sweep(const char *file_name, sweep_run_t *runs, int run_ct, int workers, int statistics)
+{
+	struct timespec start_time;
+	int i, failed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	trace_reader_t trace;
+	const trace_job_t *jobs = NULL;
+	int job_ct = load_jobs(file_name, &trace, &jobs);
+	if (job_ct == -1)
+		return 2;
+
+	double load_seconds = elapsed_seconds(&start_time);
+
+	sweep_t sweep = {runs, run_ct, 0, jobs, job_ct, PTHREAD_MUTEX_INITIALIZER};
+	if (workers > run_ct)
+		workers = run_ct;
+	pthread_t *threads = malloc(workers * sizeof(pthread_t));
+	int started = 0;
+
+	/*
+	 * If a worker cannot be started, the ones that were share the runs;
+	 * with none at all, this thread runs them.
+	 */
+	while (threads && started < workers && pthread_create(&threads[started], NULL, sweep_worker, &sweep) == 0)
+		started++;
+	if (started < workers)
+		fprintf(stderr, "Unable to start %d of %d worker threads; continuing with %d.\n", workers - started, workers, started);
+	if (started == 0)
+		sweep_worker(&sweep);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	workers = (started > 0) ? started : 1;
+
+	double run_seconds = elapsed_seconds(&start_time) - load_seconds;
+
+	printf("cores,scheme,average_waiting_time,average_turnaround_time,average_response_time,migrations,steals\n");
+	for (i = 0; i < run_ct; i++)
+	{
+		simulator_options_t *options = &runs[i].options;
+		char scheme[32];
+
+		if (options->scheme == RR)
+			snprintf(scheme, sizeof(scheme), "rr%d", options->quantum);
 		else
-			printf("%d, ", i);
+			strcpy(scheme, scheme_names[options->scheme]);
+
+		if (runs[i].status != 0)
+		{
+			fprintf(stderr, "The simulation with -c %d -s %s failed.\n", options->cores, scheme);
+			failed = runs[i].status;
+			continue;
+		}
+
+		printf("%d,%s,%.2f,%.2f,%.2f,%ld,%ld\n", options->cores, scheme,
+				runs[i].stats.average_waiting_time, runs[i].stats.average_turnaround_time, runs[i].stats.average_response_time,
+				runs[i].stats.migrations, runs[i].stats.steals);
 	}
+
+	if (statistics)
+	{
+		struct rusage usage;
+
+		getrusage(RUSAGE_SELF, &usage);
+		fprintf(stderr, "stats: jobs=%d configurations=%d workers=%d load_s=%.6f run_s=%.6f configurations_per_s=%.1f max_rss_kb=%ld\n",
+				job_ct, run_ct, workers, load_seconds, run_seconds,
+				(run_seconds > 0) ? run_ct / run_seconds : 0,
+				usage.ru_maxrss);
+	}
+
+	free(threads);
+	unload_jobs(&trace, jobs);
+	return failed;
 }
 
 
 int main(int argc, char **argv)
 {
 	int c;
-	int cores = 0, scheme = -1, quantum = 0;
-	char *file_name;
+	int cores = 0, scheme = -1, quantum = 0, event_driven = 0;
+	int verbose = 1, summary = 1, streaming = 0, statistics = 0, balance = 0;
+	char *file_name, *scheme_spec = NULL;
+	int *core_list = NULL, core_ct = 0, *quanta = NULL, quantum_ct = 0;
+	int workers = (int)sysconf(_SC_NPROCESSORS_ONLN), unit_us = 0;
+	long value;
+	char *end;
+
+	// Released at cleanup when main gives up or a sweep is done
+	sweep_run_t *runs = NULL, *sweep = NULL;
+	int result = 1;
 
 	/*
 	 * Parse command line options.
 	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
+	while ((c = getopt(argc, argv, "c:s:r:j:x:eSqQTL")) != -1)
 	{
 		switch (c)
 		{
+			case 'e':
+				event_driven = 1;
+				break;
+
+			case 'S':
+				streaming = 1;
+				break;
+
+			case 'T':
+				statistics = 1;
+				break;
+
+			case 'L':
+				balance = 1;
+				break;
+
+			case 'q':
+				verbose = 0;
+				break;
+
+			case 'Q':
+				verbose = 0;
+				summary = 0;
+				break;
+
 			case 'c':
-				cores = atoi(optarg);
+				free(core_list);
+				core_ct = parse_numbers(optarg, &core_list);
 
-				if (cores <= 0)
+				if (core_ct <= 0)
 				{
 					fprintf(stderr, "Option -c <cores> require a positive number.\n");
 					print_usage(argv[0]);
-					return 1;
+					goto cleanup;
 				}
+				cores = core_list[0];
 				break;
 
 			case 's':
-				if (strcasecmp(optarg, "FCFS") == 0) { scheme = FCFS; }
-				else if (strcasecmp(optarg, "SJF") == 0) { scheme = SJF; }
-				else if (strcasecmp(optarg, "PSJF") == 0) { scheme = PSJF; }
-				else if (strcasecmp(optarg, "PRI") == 0) { scheme = PRI; }
-				else if (strcasecmp(optarg, "PPRI") == 0) { scheme = PPRI; }
-				else if (strncasecmp(optarg, "RR", 2) == 0)
+				scheme_spec = optarg;
+				break;
+
+			case 'r':
+				free(quanta);
+				quantum_ct = parse_numbers(optarg, &quanta);
+
+				if (quantum_ct <= 0)
+				{
+					fprintf(stderr, "Option -r <quanta> requires positive numbers.\n");
+					print_usage(argv[0]);
+					goto cleanup;
+				}
+				break;
+
+			case 'j':
+				errno = 0;
+				value = strtol(optarg, &end, 10);
+				workers = (end != optarg && *end == '\0' && errno == 0 && value > 0 && value <= INT_MAX) ? (int)value : 0;
+
+				if (workers <= 0)
 				{
-					scheme = RR;
-					quantum = atoi(optarg + 2);
-
-					if (quantum <= 0)
-					{
-						fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR. (Eg: -s RR2)\n");
-						print_usage(argv[0]);
-						return 1;
-					}
+					fprintf(stderr, "Option -j <workers> requires a positive number.\n");
+					print_usage(argv[0]);
+					goto cleanup;
+				}
+				break;
+
+			case 'x':
+				errno = 0;
+				value = strtol(optarg, &end, 10);
+				unit_us = (end != optarg && *end == '\0' && errno == 0 && value > 0 && value <= INT_MAX / 1000) ? (int)value : 0;
+
+				if (unit_us <= 0)
+				{
+					fprintf(stderr, "Option -x <us> requires a positive number.\n");
+					print_usage(argv[0]);
+					goto cleanup;
 				}
 				break;
 
 			case '?':
 				print_usage(argv[0]);
-				return 1;
+				goto cleanup;
 
 			default:
 				printf("...\n");
@@ -137,356 +491,225 @@ int main(int argc, char **argv)
 	{
 		fprintf(stderr, "Required option -c <cores> is not present.\n");
 		print_usage(argv[0]);
-		return 1;
+		goto cleanup;
 	}
 
-	if (scheme == -1)
+	int scheme_ct = scheme_spec ? parse_schemes(scheme_spec, quanta, quantum_ct, &runs) : -1;
+
+	if (scheme_ct == -3)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		result = 2;
+		goto cleanup;
+	}
+
+	if (scheme_ct == -2)
+	{
+		fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR. (Eg: -s RR2)\n");
+		print_usage(argv[0]);
+		goto cleanup;
+	}
+
+	if (scheme_ct <= 0)
 	{
 		fprintf(stderr, "Required option -s <scheme> is not present.\n");
 		print_usage(argv[0]);
-		return 1;
+		goto cleanup;
 	}
 
+	scheme = runs[0].options.scheme;
+	quantum = runs[0].options.quantum;
+
 	if (optind == argc - 1)
 		file_name = argv[optind];
 	else
 	{
 		fprintf(stderr, "A single input file is required.\n");
 		print_usage(argv[0]);
-		return 1;
+		goto cleanup;
 	}
 
 
 	/*
-	 * Open the file, read the file, and populate the jobs data structure.
+	 * Several core counts or schemes make a sweep: every combination runs
+	 * over one shared copy of the input and only the averages are printed.
 	 */
-	FILE *file = fopen(file_name, "r");
-	if (file == NULL)
-	{
-		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
-		return 2;
-	}
-
-
-	int job_id = 0;
-	int jobs_ct = 10;
-	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
-
-	char line[1024 + 1];
-	fgets(line, 1024, file);  // Ignore the first (header) line
-	while (fgets(line, 1024, file) != NULL)
+	if (core_ct * scheme_ct > 1)
 	{
-		char *arrival_time = strtok(line, ",");
-		char *run_time = strtok(NULL, ",");
-		char *priority = strtok(NULL, ",");
-
-		if (arrival_time != NULL && run_time != NULL && priority != NULL)
+		if (unit_us > 0)
 		{
-			if (job_id == jobs_ct)
-			{
-				jobs_ct *= 2;
-				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
-
-				if (!jobs)
-				{
-					fprintf(stderr, "Out of memory.\n");
-					return 2;
-				}
-			}
-
-			jobs[job_id].job_id = job_id;
-			jobs[job_id].arrival_time = atoi(arrival_time);
-			jobs[job_id].run_time = atoi(run_time);
-			jobs[job_id].priority = atoi(priority);
-			jobs[job_id].core_id = -1;
-			jobs[job_id].arrived = 0;
-
-			job_id++;
+			fprintf(stderr, "Option -x cannot be used with several core counts or schemes.\n");
+			print_usage(argv[0]);
+			goto cleanup;
 		}
-		else
+
+		if (streaming)
 		{
-			fprintf(stderr, "Illegal file format.\n");
-			return 2;
+			fprintf(stderr, "Option -S cannot be used with several core counts or schemes.\n");
+			print_usage(argv[0]);
+			goto cleanup;
 		}
-	}
-
-	fclose(file);
-
 
-	/*
-	 * Run the simulation.
-	 */
-
-	printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
-	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
-	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
-	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
-	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
-	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
-	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
-	printf(" scheduling...\n\n");
-
-	scheduler_start_up(cores, scheme);
-
-
-	int time = 0, i, j;
-	int active_jobs = job_id, jobs_alive = 0;
+		int i, j;
 
-	int *quantum_clock = malloc(cores * sizeof(int));
-	char **core_timing_diagram = malloc(cores * sizeof(char *));
-	int core_timing_diagram_size = 1024;
-
-	for (i = 0; i < cores; i++)
-	{
-		quantum_clock[i] = -1;
-		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-		core_timing_diagram[i][0] = '\0';
-	}
-
-	while (active_jobs > 0)
-	{
-		printf("=== [TIME %d] ===\n", time);
-
-		/*
-		 * 1. Check if any jobs finished in the last time unit.
-		 */
-		for (i = 0; i < active_jobs; i++)
+		if (core_ct > INT_MAX / scheme_ct)
 		{
-			if (jobs[i].run_time == 0)
-			{
-				// Notify the scheduler has finished
-				int job_id = jobs[i].job_id;
-				int core_id = jobs[i].core_id;
-				int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
-
-				if (scheme == RR)
-					quantum_clock[jobs[i].core_id] = quantum;
-
-				// Delete the finished jobs, decrease the number of active jobs
-				if (i != active_jobs - 1)
-					memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-				active_jobs--;
-				jobs_alive--;
-				i--;
-
-				// Set the new job
-				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-				{
-					printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-					print_available_jobs(jobs, active_jobs);
-					return 3;
-				}
-				else
-				{
-					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-			}
+			fprintf(stderr, "Too many configurations.\n");
+			goto cleanup;
 		}
 
-		/*
-		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
-		 */
-		if (active_jobs == 0)
-			break;
-
-		/*
-		 * 2. Check of any quantums expired in the last time unit.
-		 */
-		if (scheme == RR)
+		sweep = malloc((size_t)core_ct * scheme_ct * sizeof(sweep_run_t));
+		if (!sweep)
 		{
-			for (i = 0; i < cores; i++)
-			{
-				if (quantum_clock[i] == 0)
-				{
-					for (j = 0; j < active_jobs; j++)
-					{
-						if (jobs[j].core_id == i)
-						{
-							// Notify the scheduler the quantum has expired
-							int core_id = jobs[j].core_id;
-							int old_job_id = jobs[j].job_id;
-							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-							jobs[j].core_id = -1;
-
-							quantum_clock[core_id] = quantum;
-
-							// Set the new job
-							if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-							{
-								printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-								print_available_jobs(jobs, active_jobs);
-								return 3;
-							}
-							else
-							{
-								printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
-								printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-							}
-
-							break;
-						}
-					}
-				}
-			}
+			fprintf(stderr, "Out of memory.\n");
+			result = 2;
+			goto cleanup;
 		}
 
-
-		/*
-		 * 3. Check for any new jobs that arrive in this time unit
-		 */
-		for (i = 0; i < active_jobs; i++)
+		for (i = 0; i < core_ct; i++)
 		{
-			if (jobs[i].arrival_time == time)
+			for (j = 0; j < scheme_ct; j++)
 			{
-				int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-				jobs[i].arrived = 1;
-				jobs_alive++;
-
-				if (new_job_core_id >= 0 && new_job_core_id < cores)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-
-					// Find if anyone is currently using the core.
-					for (j = 0; j < active_jobs; j++)
-						if (jobs[j].core_id == new_job_core_id)
-							jobs[j].core_id = -1;
-
-					// Assign the core to the new job
-					jobs[i].core_id = new_job_core_id;
+				sweep_run_t *run = &sweep[i * scheme_ct + j];
 
-					if (scheme == RR)
-						quantum_clock[new_job_core_id] = quantum;
-				}
-				else if (new_job_core_id == -1)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-				else
-				{
-					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
-					print_available_cores(cores);
-					return 3;
-				}
+				*run = runs[j];
+				run->options.cores = core_list[i];
+				run->options.event_driven = event_driven;
+				run->options.quiet = 1;
 			}
 		}
 
+		result = run_sweep(file_name, sweep, core_ct * scheme_ct, workers, statistics);
+		goto cleanup;
+	}
 
-		/*
-		 * 4. Run the time unit.
-		 */
-		char time_string[cores][11];
-		int cores_working = 0;
+	free(runs);
+	free(core_list);
+	free(quanta);
+	runs = NULL;
+	core_list = quanta = NULL;
 
-		for (i = 0; i < cores; i++)
-			time_string[i][0] = '\0';
 
-		for (i = 0; i < active_jobs; i++)
+	/*
+	 * Execute instead of simulating: the jobs run as busy work on real
+	 * threads and the averages printed are measured, not simulated.
+	 */
+	if (unit_us > 0)
+	{
+		if (streaming)
 		{
-			if (jobs[i].core_id != -1)
-			{
-				cores_working++;
-				jobs[i].run_time--;
-				quantum_clock[jobs[i].core_id]--;
-
-				assert(time_string[jobs[i].core_id][0] == '\0');
-
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
-			}
+			fprintf(stderr, "Option -x cannot be used with -S.\n");
+			print_usage(argv[0]);
+			return 1;
 		}
 
-		for (i = 0; i < cores; i++)
-		{
-			// If the core is idle, print a '-'
-			if (time_string[i][0] == '\0')
-				strcpy(time_string[i], "-");
+		trace_reader_t trace;
+		const trace_job_t *jobs = NULL;
+		int job_ct = load_jobs(file_name, &trace, &jobs), status;
 
-			// Ensure we have enough memory
-			while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size)
-			{
-				core_timing_diagram_size *= 2;
+		if (job_ct == -1)
+			return 2;
 
-				for (j = 0; j < cores; j++)
-				{
-					core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
+		executor_options_t options = {
+			.cores = cores,
+			.scheme = scheme,
+			.quantum = quantum,
+			.unit_us = unit_us,
+			.verbose = verbose,
+			.out = stdout,
+		};
+		executor_stats_t stats;
 
-					if (core_timing_diagram[j] == NULL)
-					{
-						fprintf(stderr, "Out of memory.\n");
-						return 3;
-					}
-				}
-			}
-
-			strcat( core_timing_diagram[i], time_string[i] );
-		}
+		status = execute(&options, jobs, job_ct, &stats);
 
+		if (status == 0 && statistics)
+			fprintf(stderr, "stats: jobs=%d cores=%d preemptions=%ld run_s=%.6f\n",
+					stats.jobs, cores, stats.preemptions, stats.seconds);
 
-		/*
-		 * 5. Print data!
-		 */
-		printf("At the end of time unit %d...\n", time);
+		unload_jobs(&trace, jobs);
+		return status;
+	}
 
-		for (i = 0; i < cores; i++)
-			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
 
-		printf("\n");
+	/*
+	 * Open the file and read the jobs.  When streaming, they are read by
+	 * the simulation as they arrive instead.
+	 */
+	struct timespec start_time;
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
 
-		printf("  Queue: ");
-		scheduler_show_queue();
-		printf("\n");
-		printf("\n");
+	trace_reader_t trace;
+	int job_ct = 0, status = 0;
+	const trace_job_t* jobs = NULL;
 
+	if (streaming ? trace_open_stream(&trace, file_name) != 0 : (job_ct = load_jobs(file_name, &trace, &jobs)) == -1)
+		return 2;
 
-		/*
-		 * 6. Sanity Checking
-		 *
-		 * - If there's a job alive (needing to be ran) and all CPUs are idle, the scheduler failed to schedule properly.
-		 */
-		if (jobs_alive > 0 && cores_working == 0)
-		{
-			printf("All cores are idle and at least one job remains unscheduled.\n");
-			print_available_jobs(jobs, active_jobs);
-			return 3;
-		}
 
+	/*
+	 * Run the simulation.
+	 */
 
-		/*
-		 * 7. Increase time
-		 */
-		time++;
+	/*
+	 * The verbose trace is made of many small writes and can run to many
+	 * megabytes; a large stdout buffer turns them into few large writes.
+	 */
+	if (verbose)
+		setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+	simulator_options_t options = {
+		.cores = cores,
+		.scheme = scheme,
+		.quantum = quantum,
+		.event_driven = event_driven,
+		.verbose = verbose,
+		.summary = summary,
+		.out = stdout,
+		.balance = balance,
+	};
+	simulator_stats_t stats;
+
+	double load_seconds = elapsed_seconds(&start_time);
+
+	if (streaming)
+	{
+		status = simulate_stream(&options, &trace, &stats);
+		trace_close(&trace);
+	}
+	else
+	{
+		status = simulate(&options, jobs, job_ct, &stats);
+		unload_jobs(&trace, jobs);
 	}
 
+	if (status != 0)
+		return status;
 
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
-
-	scheduler_clean_up();
+	double total_seconds = elapsed_seconds(&start_time);
 
 
-	free(quantum_clock);
-	for (i=0; i < cores; i++)
-		free(core_timing_diagram[i]);
-	free(core_timing_diagram);
-	free(jobs);
+	/*
+	 * One line of key=value pairs, for benchmark scripts to parse.
+	 */
+	if (statistics)
+	{
+		struct rusage usage;
+		double run_seconds = total_seconds - load_seconds;
+
+		getrusage(RUSAGE_SELF, &usage);
+		fprintf(stderr, "stats: jobs=%d cores=%d calls=%lld steps=%lld time_units=%d load_s=%.6f run_s=%.6f calls_per_s=%.0f time_units_per_s=%.0f max_rss_kb=%ld migrations=%ld steals=%ld\n",
+				stats.jobs, cores, stats.scheduler_calls, stats.steps, stats.time, load_seconds, run_seconds,
+				(run_seconds > 0) ? stats.scheduler_calls / run_seconds : 0,
+				(run_seconds > 0) ? stats.time / run_seconds : 0,
+				usage.ru_maxrss, stats.migrations, stats.steals);
+	}
 
 	return 0;
+
+cleanup:
+	free(sweep);
+	free(runs);
+	free(core_list);
+	free(quanta);
+	return result;
 }
@@ -0,0 +1,449 @@
+/** @file tracegen.c
+
+  Generates synthetic job traces for scaling experiments. The output only
+  depends on the options and the seed, so a benchmark can be reproduced
+  exactly from its command line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "libtrace/libtrace.h"
+
+/**
+  Largest number of weights accepted by -p weights:...
+*/
+#define TRACEGEN_MAX_WEIGHTS 64
+
+/**
+  Cap on sampled run times, so heavy tails cannot overflow simulated time
+*/
+#define TRACEGEN_MAX_RUN_TIME 1000000
+
+typedef enum {ARRIVAL_POISSON = 0, ARRIVAL_BURSTY} arrival_model_t;
+typedef enum {RUN_EXPONENTIAL = 0, RUN_BIMODAL, RUN_PARETO} run_model_t;
+typedef enum {PRIORITY_UNIFORM = 0, PRIORITY_WEIGHTS} priority_model_t;
+
+typedef struct _workload_t
+{
+	arrival_model_t arrival_model;
+	double mean_gap;//mean time between arrivals (ARRIVAL_POISSON) or between bursts (ARRIVAL_BURSTY)
+	double burst_size;//mean number of jobs in a burst (ARRIVAL_BURSTY)
+
+	run_model_t run_model;
+	double run_mean;//mean run time (RUN_EXPONENTIAL), or of short jobs (RUN_BIMODAL)
+	double run_long_mean;//mean run time of long jobs (RUN_BIMODAL)
+	double run_long_fraction;//share of long jobs (RUN_BIMODAL)
+	double run_alpha;//tail index (RUN_PARETO)
+	double run_min;//smallest run time (RUN_PARETO)
+
+	priority_model_t priority_model;
+	int priority_low, priority_high;//range of priorities (PRIORITY_UNIFORM)
+	double weights[TRACEGEN_MAX_WEIGHTS];//weight of each priority from 0 (PRIORITY_WEIGHTS)
+	int weight_count;
+	double weight_total;
+} workload_t;
+
+
+/*
+ * xoshiro256** seeded through splitmix64: fast, and unlike rand() it gives
+ * the same sequence on every platform.
+ */
+static uint64_t rng_state[4];
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static void rng_seed(uint64_t seed)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		rng_state[i] = splitmix64(&seed);
+}
+
+static uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t rng_next()
+{
+	uint64_t result = rotl(rng_state[1] * 5, 7) * 9;
+	uint64_t t = rng_state[1] << 17;
+
+	rng_state[2] ^= rng_state[0];
+	rng_state[3] ^= rng_state[1];
+	rng_state[1] ^= rng_state[2];
+	rng_state[0] ^= rng_state[3];
+	rng_state[2] ^= t;
+	rng_state[3] = rotl(rng_state[3], 45);
+
+	return result;
+}
+
+/* Uniform in (0, 1]. */
+static double rng_uniform()
+{
+	return ((rng_next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_exponential(double mean)
+{
+	return -mean * log(rng_uniform());
+}
+
+/* Rounds a positive sample up to a whole number of time units. */
+static int to_time(double x)
+{
+	if (x >= TRACEGEN_MAX_RUN_TIME)
+		return TRACEGEN_MAX_RUN_TIME;
+	return (x < 1) ? 1 : (int)ceil(x);
+}
+
+
+static int sample_run_time(workload_t *w)
+{
+	switch (w->run_model)
+	{
+		case RUN_BIMODAL:
+			if (rng_uniform() <= w->run_long_fraction)
+				return to_time(rng_exponential(w->run_long_mean));
+			return to_time(rng_exponential(w->run_mean));
+
+		case RUN_PARETO:
+			return to_time(w->run_min / pow(rng_uniform(), 1.0 / w->run_alpha));
+
+		default:
+			return to_time(rng_exponential(w->run_mean));
+	}
+}
+
+static int sample_priority(workload_t *w)
+{
+	if (w->priority_model == PRIORITY_WEIGHTS)
+	{
+		double x = (1.0 - rng_uniform()) * w->weight_total;
+		int i;
+
+		for (i = 0; i < w->weight_count - 1; i++)
+		{
+			if (x < w->weights[i])
+				return i;
+			x -= w->weights[i];
+		}
+		return w->weight_count - 1;
+	}
+
+	return w->priority_low + (int)(rng_next() % (uint64_t)(w->priority_high - w->priority_low + 1));
+}
+
+
+/*
+ * Parses "name:v1,v2,..." into at most max values. Returns the number of
+ * values, or -1 if spec does not start with name or holds something other
+ * than numbers.
+ */
+static int parse_spec(const char *spec, const char *name, double *values, int max)
+{
+	size_t length = strlen(name);
+	int count = 0;
+
+	if (strncmp(spec, name, length) != 0 || (spec[length] != ':' && spec[length] != '\0'))
+		return -1;
+
+	const char* p = spec + length;
+	while (*p == ((count == 0) ? ':' : ','))
+	{
+		char* end;
+
+		if (count == max)
+			return -1;
+		values[count] = strtod(p + 1, &end);
+		if (end == p + 1)
+			return -1;
+		count++;
+		p = end;
+	}
+
+	return (*p == '\0') ? count : -1;
+}
+
+static int parse_arrivals(workload_t *w, const char *spec)
+{
+	double v[2];
+	int n;
+
+	if ((n = parse_spec(spec, "poisson", v, 1)) >= 0)
+	{
+		w->arrival_model = ARRIVAL_POISSON;
+		w->mean_gap = (n > 0) ? v[0] : 2.0;
+		return w->mean_gap > 0;
+	}
+	if ((n = parse_spec(spec, "bursty", v, 2)) >= 0)
+	{
+		w->arrival_model = ARRIVAL_BURSTY;
+		w->mean_gap = (n > 0) ? v[0] : 20.0;
+		w->burst_size = (n > 1) ? v[1] : 8.0;
+		return w->mean_gap > 0 && w->burst_size >= 1;
+	}
+	return 0;
+}
+
+static int parse_run_times(workload_t *w, const char *spec)
+{
+	double v[3];
+	int n;
+
+	if ((n = parse_spec(spec, "exp", v, 1)) >= 0)
+	{
+		w->run_model = RUN_EXPONENTIAL;
+		w->run_mean = (n > 0) ? v[0] : 5.0;
+		return w->run_mean > 0;
+	}
+	if ((n = parse_spec(spec, "bimodal", v, 3)) >= 0)
+	{
+		w->run_model = RUN_BIMODAL;
+		w->run_mean = (n > 0) ? v[0] : 2.0;
+		w->run_long_mean = (n > 1) ? v[1] : 50.0;
+		w->run_long_fraction = (n > 2) ? v[2] : 0.1;
+		return w->run_mean > 0 && w->run_long_mean > 0 && w->run_long_fraction >= 0 && w->run_long_fraction <= 1;
+	}
+	if ((n = parse_spec(spec, "pareto", v, 2)) >= 0)
+	{
+		w->run_model = RUN_PARETO;
+		w->run_alpha = (n > 0) ? v[0] : 1.5;
+		w->run_min = (n > 1) ? v[1] : 1.0;
+		return w->run_alpha > 0 && w->run_min > 0;
+	}
+	return 0;
+}
+
+static int parse_priorities(workload_t *w, const char *spec)
+{
+	double v[TRACEGEN_MAX_WEIGHTS];
+	int n, i;
+
+	if ((n = parse_spec(spec, "uniform", v, 2)) >= 0)
+	{
+		w->priority_model = PRIORITY_UNIFORM;
+		w->priority_low = (n > 1) ? (int)v[0] : 0;
+		w->priority_high = (n > 1) ? (int)v[1] : ((n > 0) ? (int)v[0] : 9);
+		return w->priority_low <= w->priority_high;
+	}
+	if ((n = parse_spec(spec, "weights", v, TRACEGEN_MAX_WEIGHTS)) > 0)
+	{
+		w->priority_model = PRIORITY_WEIGHTS;
+		w->weight_count = n;
+		w->weight_total = 0;
+		for (i = 0; i < n; i++)
+		{
+			if (v[i] < 0)
+				return 0;
+			w->weights[i] = v[i];
+			w->weight_total += v[i];
+		}
+		return w->weight_total > 0;
+	}
+	return 0;
+}
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s -n <jobs> [-s <seed>] [-a <arrivals>] [-r <run times>] [-p <priorities>] [-o <output> [-b]]\n", program_name);
+	fprintf(stderr, "       %s -n 1000000 -s 42 -a bursty:20,8 -r pareto:1.5 -o big.trace -b\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Arrivals:   poisson[:mean gap]                 (default poisson:2)\n");
+	fprintf(stderr, "            bursty[:mean gap between bursts,mean burst size]\n");
+	fprintf(stderr, "Run times:  exp[:mean]                         (default exp:5)\n");
+	fprintf(stderr, "            bimodal[:short mean,long mean,long fraction]\n");
+	fprintf(stderr, "            pareto[:alpha,minimum]\n");
+	fprintf(stderr, "Priorities: uniform[:low,high]                 (default uniform:0,9)\n");
+	fprintf(stderr, "            weights:w0,w1,...  (priority i is drawn with weight wi)\n");
+	fprintf(stderr, "  -b  write a binary trace instead of CSV (needs -o)\n");
+}
+
+int main(int argc, char **argv)
+{
+	workload_t w;
+	long long jobs = -1;
+	unsigned long long seed = 1;
+	char *output = NULL, *end;
+	int binary = 0, c;
+
+	parse_arrivals(&w, "poisson");
+	parse_run_times(&w, "exp");
+	parse_priorities(&w, "uniform");
+
+	while ((c = getopt(argc, argv, "n:s:a:r:p:o:b")) != -1)
+	{
+		switch (c)
+		{
+			case 'n':
+				errno = 0;
+				jobs = strtoll(optarg, &end, 10);
+
+				if (end == optarg || *end != '\0' || errno != 0 || jobs < 0 || jobs > INT_MAX)
+				{
+					fprintf(stderr, "Option -n <jobs> requires a number of jobs from 0 to %d.\n", INT_MAX);
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 's':
+				errno = 0;
+				seed = strtoull(optarg, &end, 0);
+
+				if (end == optarg || *end != '\0' || errno != 0 || optarg[0] == '-')
+				{
+					fprintf(stderr, "Option -s <seed> requires a non-negative number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'a':
+				if (!parse_arrivals(&w, optarg))
+				{
+					fprintf(stderr, "Invalid arrival model \"%s\".\n", optarg);
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'r':
+				if (!parse_run_times(&w, optarg))
+				{
+					fprintf(stderr, "Invalid run time model \"%s\".\n", optarg);
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'p':
+				if (!parse_priorities(&w, optarg))
+				{
+					fprintf(stderr, "Invalid priority model \"%s\".\n", optarg);
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'o':
+				output = optarg;
+				break;
+
+			case 'b':
+				binary = 1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (jobs < 0 || jobs > INT_MAX || optind != argc)
+	{
+		fprintf(stderr, "Option -n <jobs> requires a number of jobs.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (binary && output == NULL)
+	{
+		fprintf(stderr, "Option -b requires an output file (-o).\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	rng_seed(seed);
+
+	FILE* file = stdout;
+	trace_job_t* records = NULL;
+
+	if (binary)
+	{
+		records = malloc(jobs * sizeof(trace_job_t));
+		if (jobs > 0 && !records)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			return 2;
+		}
+	}
+	else
+	{
+		if (output != NULL && (file = fopen(output, "w")) == NULL)
+		{
+			fprintf(stderr, "Unable to open file \"%s\".\n", output);
+			return 2;
+		}
+		fprintf(file, "\"Arrival time\",\"Run time\",\"Priority\"\n");
+	}
+
+	double clock = 0;
+	int burst_left = 0;
+	long long i;
+
+	for (i = 0; i < jobs; i++)
+	{
+		trace_job_t job;
+
+		if (w.arrival_model == ARRIVAL_BURSTY)
+		{
+			// Bursts of geometrically many jobs arrive together, with exponential gaps between bursts
+			if (burst_left == 0)
+			{
+				if (i > 0)
+					clock += rng_exponential(w.mean_gap);
+				burst_left = 1;
+				if (w.burst_size > 1)
+					burst_left += (int)fmin(floor(log(rng_uniform()) / log(1.0 - 1.0 / w.burst_size)), INT_MAX - 1);
+			}
+			burst_left--;
+		}
+		else if (i > 0)
+			clock += rng_exponential(w.mean_gap);
+
+		if (clock >= INT_MAX)
+		{
+			fprintf(stderr, "Arrival times no longer fit in an int after %lld jobs.\n", i);
+			return 2;
+		}
+
+		job.arrival_time = (int)clock;
+		job.run_time = sample_run_time(&w);
+		job.priority = sample_priority(&w);
+
+		if (binary)
+			records[i] = job;
+		else
+			fprintf(file, "%d,%d,%d\n", job.arrival_time, job.run_time, job.priority);
+	}
+
+	if (binary)
+	{
+		if (trace_write(output, records, (int)jobs) != 0)
+			return 2;
+		free(records);
+	}
+	else if (fflush(file) != 0 || (file != stdout && fclose(file) != 0))
+	{
+		fprintf(stderr, "Unable to write the trace.\n");
+		return 2;
+	}
+
+	return 0;
+}